@@ -20,18 +20,34 @@
 #include <asm/unaligned.h>
 #endif
 
+#include <linux/completion.h>
 #include <linux/crc16.h>
 #include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/hid.h>
+#include <linux/hidraw.h>
 #include <linux/hwmon.h>
 #include <linux/hwmon-sysfs.h>
 #include <linux/jiffies.h>
+#include <linux/kref.h>
 #include <linux/ktime.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/seq_file.h>
+#include <linux/spinlock.h>
 #include <linux/usb.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <net/genetlink.h>
+
+#if IS_REACHABLE(CONFIG_IIO_KFIFO_BUF) && KERNEL_VERSION(5, 13, 0) <= LINUX_VERSION_CODE
+#define AQC_IIO_BUFFER
+#include <linux/iio/buffer.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/kfifo_buf.h>
+#endif
 
 #define USB_VENDOR_ID_AQUACOMPUTER	0x0c70
 #define USB_PRODUCT_ID_AQUAERO		0xf001
@@ -74,12 +90,77 @@ static const char *const aqc_device_names[] = {
 
 #define STATUS_REPORT_ID		0x01
 #define STATUS_UPDATE_INTERVAL		(2 * HZ)	/* In seconds */
+
+#define AQC_MAX_TEMP_CHANNELS		40
+#define AQC_MAX_SPEED_CHANNELS		20
+#define AQC_MAX_POWER_CHANNELS		8
+/* Temperature, speed, power, voltage and current readings that make up a sample */
+#define AQC_MAX_SAMPLE_CHANNELS		(AQC_MAX_TEMP_CHANNELS + AQC_MAX_SPEED_CHANNELS + \
+					 3 * AQC_MAX_POWER_CHANNELS)
+/* Pushed in place of a reading that isn't available, such as a disconnected sensor */
+#define AQC_SAMPLE_NONE			S32_MIN
+
+/* Sensor reports are pushed about once per AQC_REPORT_PERIOD */
+#define AQC_REPORT_PERIOD		1000	/* ms */
+#define AQC_REPORT_GAP_FACTOR		2
+
+/* Upper bounds of the inter-arrival jitter histogram buckets, the last one is open */
+static const unsigned int aqc_report_jitter_bounds[] = { 10, 50, 100, 250, 500 };	/* ms */
+#define AQC_REPORT_JITTER_BUCKETS	(ARRAY_SIZE(aqc_report_jitter_bounds) + 1)
+
+/* Longest time without reads after which the input stream can be closed */
+#define AQC_IDLE_TIMEOUT_MAX		86400	/* s */
+
+/* Each new rate sample contributes 1/AQC_TREND_WEIGHT to the trend */
+#define AQC_TREND_WEIGHT		4
+/* Longest gap between readings a trend is carried over, long enough for legacy devices */
+#define AQC_TREND_MAX_GAP		30000	/* ms */
 #define SERIAL_PART_OFFSET		2
 
 #define CTRL_REPORT_ID			0x03
 #define AQUAERO_CTRL_REPORT_ID		0x0b
 
 #define CTRL_REPORT_DELAY		200	/* ms */
+#define CTRL_REPORT_DELAY_MAX		1000	/* ms */
+/* Shortest delay calibration settles on for devices that need spacing at all */
+#define CTRL_REPORT_DELAY_MIN		20	/* ms */
+
+/*
+ * Report spacings tried when calibrating, from the safest one down. Each one is
+ * accepted only if the device answered every request of a round correctly
+ */
+static const int aqc_ctrl_report_delay_steps[] = { CTRL_REPORT_DELAY, 150, 100, 75, 50, 25, 10, 0 };
+#define CTRL_REPORT_CALIBRATION_ROUNDS	8
+
+/* Transient control report errors are retried, backing off longer after each attempt */
+#define CTRL_REPORT_RETRIES		3
+/* In ms on top of the delay, doubled for every retry */
+#define CTRL_REPORT_RETRY_BACKOFF	20
+/* After this many requests in a row fail, the link is considered down */
+#define CTRL_REPORT_FAIL_THRESHOLD	3
+/* While the link is down, requests fail at once, except for one probe per interval */
+#define CTRL_REPORT_PROBE_INTERVAL	(5 * HZ)
+
+/* Longest exclusive control report lease that can be granted to hidraw users */
+#define CTRL_REPORT_LEASE_MAX		3600	/* s */
+
+enum aqc_link_health { AQC_LINK_OK, AQC_LINK_DEGRADED, AQC_LINK_FAILED };
+
+static const char *const aqc_link_health_names[] = {
+	[AQC_LINK_OK] = "ok",
+	[AQC_LINK_DEGRADED] = "degraded",
+	[AQC_LINK_FAILED] = "failed",
+};
+
+static bool calibrate_ctrl_report_delay;
+module_param(calibrate_ctrl_report_delay, bool, 0444);
+MODULE_PARM_DESC(calibrate_ctrl_report_delay,
+		 "Calibrate the delay between control report operations on probe");
+
+/* Control report images that can be saved per device and applied with a single write */
+#define AQC_NUM_DEVICE_PROFILES		4
+#define AQC_NUM_PROFILE_SLOTS		4
+#define AQC_PROFILE_NAME_LEN		16
 
 /*
  * The HID report that the official software always sends
@@ -113,6 +194,15 @@ static u8 aquastreamxt_secondary_ctrl_report[] = {
 #define AQC_BE16	1
 #define AQC_LE16	2
 
+/* Most control report values that setting the PWM of a single channel needs to write */
+#define AQC_PWM_MAX_CTRL_VALS		4
+#define AQC_MAX_PWM_CHANNELS		8
+
+/* Interval between steps of PWM ramps done by the driver */
+#define AQC_PWM_RAMP_INTERVAL		500	/* ms */
+/* Ramps are dropped after this many steps in a row fail to be written */
+#define AQC_PWM_RAMP_MAX_FAILURES	3
+
 #define FAN_CURVE_HOLD_MIN_POWER_BIT_POS	1
 #define FAN_CURVE_START_BOOST_BIT_POS		2
 
@@ -141,6 +231,12 @@ static u8 aquastreamxt_secondary_ctrl_report[] = {
 /* Report offsets for fan control */
 #define AQC_FAN_CTRL_PWM_OFFSET		0x01
 #define AQC_FAN_CTRL_TEMP_SELECT_OFFSET	0x03
+#define AQC_FAN_CTRL_PID_TARGET_OFFSET	0x05
+#define AQC_FAN_CTRL_PID_P_OFFSET	0x07
+#define AQC_FAN_CTRL_PID_I_OFFSET	0x09
+#define AQC_FAN_CTRL_PID_D1_OFFSET	0x0B
+#define AQC_FAN_CTRL_PID_D2_OFFSET	0x0D
+#define AQC_FAN_CTRL_PID_HYST_OFFSET	0x0F
 #define AQC_FAN_CTRL_TEMP_CURVE_START	0x15
 #define AQC_FAN_CTRL_PWM_CURVE_START	0x35
 
@@ -159,6 +255,16 @@ static u8 aquastreamxt_secondary_ctrl_report[] = {
 #define AQUAERO_CTRL_PRESET_ID			0x5c
 #define AQUAERO_CTRL_PRESET_SIZE		0x02
 #define AQUAERO_CTRL_PRESET_START		0x55c
+#define AQUAERO_NUM_TWO_POINT_CTRLS		16
+#define AQUAERO_TWO_POINT_CTRL_SIZE		0x06
+#define AQUAERO_TWO_POINT_CTRL_START		0x4fc
+#define AQUAERO_NUM_SET_POINT_CTRLS		8
+#define AQUAERO_SET_POINT_CTRL_SIZE		0x10
+#define AQUAERO_SET_POINT_CTRL_START		0x59c
+#define AQUAERO_NUM_CURVE_CTRLS			4
+#define AQUAERO_CURVE_CTRL_SIZE			0x44
+#define AQUAERO_CURVE_CTRL_START		0x61c
+#define AQUAERO_CTRL_NO_TEMP_SRC		0xffff
 #define AQUAERO_5_HW_VERSION			5600
 #define AQUAERO_6_HW_VERSION			6000
 
@@ -173,7 +279,7 @@ static u8 aquastreamxt_secondary_ctrl_report[] = {
 #define AQUAERO_FAN_CURRENT_OFFSET		0x06
 #define AQUAERO_FAN_POWER_OFFSET		0x08
 #define AQUAERO_FAN_SPEED_OFFSET		0x00
-static u16 aquaero_sensor_fan_offsets[] = { 0x167, 0x173, 0x17f, 0x18B };
+static const u16 aquaero_sensor_fan_offsets[] = { 0x167, 0x173, 0x17f, 0x18B };
 #define AQUAERO_CURRENT_UPTIME_OFFSET		0x11
 #define AQUAERO_TOTAL_UPTIME_OFFSET		0x15
 
@@ -200,7 +306,7 @@ static u16 aquaero_ctrl_fan_offsets[] = { 0x20c, 0x220, 0x234, 0x248 };
 #define D5NEXT_5V_VOLTAGE		0x39
 #define D5NEXT_12V_VOLTAGE		0x37
 #define D5NEXT_VIRTUAL_SENSORS_START	0x3f
-static u16 d5next_sensor_fan_offsets[] = { D5NEXT_PUMP_OFFSET, D5NEXT_FAN_OFFSET };
+static const u16 d5next_sensor_fan_offsets[] = { D5NEXT_PUMP_OFFSET, D5NEXT_FAN_OFFSET };
 
 /* Control report offsets for the D5 Next pump */
 #define D5NEXT_TEMP_CTRL_OFFSET		0x2D	/* Temperature sensor offsets location */
@@ -232,7 +338,7 @@ static u8 d5next_ctrl_fan_curve_fallback_power_offsets[] = { 0x3D, 0x34 };
 #define AQUASTREAMULT_FAN_CURRENT_OFFSET	0x00
 #define AQUASTREAMULT_FAN_POWER_OFFSET		0x04
 #define AQUASTREAMULT_FAN_SPEED_OFFSET		0x06
-static u16 aquastreamult_sensor_fan_offsets[] = { AQUASTREAMULT_FAN_OFFSET };
+static const u16 aquastreamult_sensor_fan_offsets[] = { AQUASTREAMULT_FAN_OFFSET };
 
 /* Spec and sensor report offset for the Farbwerk RGB controller */
 #define FARBWERK_NUM_SENSORS		4
@@ -261,7 +367,7 @@ static u16 aquastreamult_sensor_fan_offsets[] = { AQUASTREAMULT_FAN_OFFSET };
 #define OCTO_SENSOR_START		0x3D
 #define OCTO_VIRTUAL_SENSORS_START	0x45
 #define OCTO_FLOW_SENSOR_OFFSET		0x7B
-static u16 octo_sensor_fan_offsets[] = { 0x7D, 0x8A, 0x97, 0xA4, 0xB1, 0xBE, 0xCB, 0xD8 };
+static const u16 octo_sensor_fan_offsets[] = { 0x7D, 0x8A, 0x97, 0xA4, 0xB1, 0xBE, 0xCB, 0xD8 };
 
 /* Control report offsets for the Octo */
 #define OCTO_TEMP_CTRL_OFFSET		0xA
@@ -297,11 +403,12 @@ static u8 octo_ctrl_fan_curve_fallback_power_offsets[] = {
 #define QUADRO_SENSOR_START		0x34
 #define QUADRO_VIRTUAL_SENSORS_START	0x3c
 #define QUADRO_FLOW_SENSOR_OFFSET	0x6e
-static u16 quadro_sensor_fan_offsets[] = { 0x70, 0x7D, 0x8A, 0x97 };
+static const u16 quadro_sensor_fan_offsets[] = { 0x70, 0x7D, 0x8A, 0x97 };
 
 /* Control report offsets for the Quadro */
 #define QUADRO_TEMP_CTRL_OFFSET		0xA
 #define QUADRO_FLOW_PULSES_CTRL_OFFSET	0x6
+#define QUADRO_PROFILE_CTRL_OFFSET	0x3BD
 /* Fan speed offsets (0-100%) */
 static u16 quadro_ctrl_fan_offsets[] = { 0x36, 0x8b, 0xe0, 0x135 };
 /* Fan curve "hold min power" and "start boost" offsets */
@@ -356,6 +463,25 @@ static u8 leakshield_usb_report_template[] = {
 	0x0, 0x0, 0x0, 0x0
 };
 
+/* USB bulk transfer that sets the virtual sensors of the Quadro and Octo */
+#define AQC_VIRT_SENSORS_REPORT_ID		0x04
+#define AQC_VIRT_SENSORS_NUM			16
+#define AQC_VIRT_SENSORS_VALUES_OFFSET		0x01
+#define AQC_VIRT_SENSORS_TYPES_OFFSET		0x21
+#define AQC_VIRT_SENSORS_TRAILER_OFFSET		0x31
+#define AQC_VIRT_SENSORS_TRAILER_VALUE		0x64
+#define AQC_VIRT_SENSORS_CHECKSUM_START		0x01
+#define AQC_VIRT_SENSORS_CHECKSUM_OFFSET	0x41
+#define AQC_VIRT_SENSORS_SIZE			0x43
+#define AQC_VIRT_SENSORS_ENDPOINT		2
+#define AQC_VIRT_SENSORS_MIN_INTERVAL		1000	/* ms */
+
+/* Virtual sensor types */
+#define AQC_VIRT_SENSOR_DISABLED	0
+#define AQC_VIRT_SENSOR_TEMP		3
+#define AQC_VIRT_SENSOR_PERCENT		5
+#define AQC_VIRT_SENSOR_POWER		7
+
 /* Specs of the Aquastream XT pump */
 #define AQUASTREAMXT_SERIAL_START		0x3a
 #define AQUASTREAMXT_FIRMWARE_VERSION		0x32
@@ -375,13 +501,30 @@ static u8 leakshield_usb_report_template[] = {
 #define AQUASTREAMXT_FAN_STATUS_OFFSET		0x1d
 #define AQUASTREAMXT_PUMP_VOLTAGE_OFFSET	0x9
 #define AQUASTREAMXT_PUMP_CURR_OFFSET		0xb
-static u16 aquastreamxt_sensor_fan_offsets[] = { 0x13, 0x1b };
+static const u16 aquastreamxt_sensor_fan_offsets[] = { 0x13, 0x1b };
 
 /* Control report offsets for Aquastream XT */
 #define AQUASTREAMXT_PUMP_MODE_CTRL_OFFSET	0x3
 #define AQUASTREAMXT_PUMP_MODE_CTRL_MANUAL	0x14
 #define AQUASTREAMXT_FAN_MODE_CTRL_OFFSET	0x1a
 #define AQUASTREAMXT_FAN_MODE_CTRL_MANUAL	0x1
+#define AQUASTREAMXT_FAN_MODE_CTRL_AUTO		0x2
+#define AQUASTREAMXT_FAN_MODE_CTRL_HOLD_MIN	0x4
+#define AQUASTREAMXT_FAN_HYST_OFFSET		0x1c
+#define AQUASTREAMXT_FAN_TEMP_SRC_OFFSET	0x1e
+#define AQUASTREAMXT_FAN_TARGET_TEMP_OFFSET	0x1f
+#define AQUASTREAMXT_FAN_P_OFFSET		0x21
+#define AQUASTREAMXT_FAN_I_OFFSET		0x23
+#define AQUASTREAMXT_FAN_D_OFFSET		0x25
+#define AQUASTREAMXT_FAN_MIN_TEMP_OFFSET	0x27
+#define AQUASTREAMXT_FAN_MAX_TEMP_OFFSET	0x29
+#define AQUASTREAMXT_FAN_MIN_PWM_OFFSET		0x2b
+#define AQUASTREAMXT_FAN_MAX_PWM_OFFSET		0x2c
+#define AQUASTREAMXT_ALARM_CONFIG_OFFSET	0xe
+#define AQUASTREAMXT_ALARM_FLOW_SPEED_OFFSET	0x12
+#define AQUASTREAMXT_ALARM_EXT_TEMP_OFFSET	0x16
+#define AQUASTREAMXT_ALARM_WATER_TEMP_OFFSET	0x18
+#define AQUASTREAMXT_FAN_CHANNEL		1
 static u16 aquastreamxt_ctrl_fan_offsets[] = { 0x8, 0x1b };
 
 /* Specs of the Poweradjust 3 */
@@ -682,7 +825,7 @@ struct aqc_fan_structure_offsets {
 };
 
 /* Fan structure offsets for Aquaero */
-static struct aqc_fan_structure_offsets aqc_aquaero_fan_structure = {
+static const struct aqc_fan_structure_offsets aqc_aquaero_fan_structure = {
 	.voltage = AQUAERO_FAN_VOLTAGE_OFFSET,
 	.curr = AQUAERO_FAN_CURRENT_OFFSET,
 	.power = AQUAERO_FAN_POWER_OFFSET,
@@ -690,7 +833,7 @@ static struct aqc_fan_structure_offsets aqc_aquaero_fan_structure = {
 };
 
 /* Fan structure offsets for Aquastream Ultimate */
-static struct aqc_fan_structure_offsets aqc_aquastreamult_fan_structure = {
+static const struct aqc_fan_structure_offsets aqc_aquastreamult_fan_structure = {
 	.voltage = AQUASTREAMULT_FAN_VOLTAGE_OFFSET,
 	.curr = AQUASTREAMULT_FAN_CURRENT_OFFSET,
 	.power = AQUASTREAMULT_FAN_POWER_OFFSET,
@@ -698,21 +841,255 @@ static struct aqc_fan_structure_offsets aqc_aquastreamult_fan_structure = {
 };
 
 /* Fan structure offsets for all devices except those above */
-static struct aqc_fan_structure_offsets aqc_general_fan_structure = {
+static const struct aqc_fan_structure_offsets aqc_general_fan_structure = {
 	.voltage = AQC_FAN_VOLTAGE_OFFSET,
 	.curr = AQC_FAN_CURRENT_OFFSET,
 	.power = AQC_FAN_POWER_OFFSET,
 	.speed = AQC_FAN_SPEED_OFFSET
 };
 
+/*
+ * Where a model keeps its readings in the sensor report, shared by all devices of
+ * that model. Temperature sensors are laid out as physical, virtual, then on the
+ * Aquaero calculated virtual and Aquabus ones, and speed channels as fans, flow
+ * sensors, then Aquabus flow sensors
+ */
+struct aqc_device_desc {
+	u8 serial_number_start_offset;
+	u8 firmware_version_offset;
+	u16 power_cycle_count_offset;	/* 0 if not reported */
+
+	int num_fans;
+	const u16 *fan_sensor_offsets;
+	const struct aqc_fan_structure_offsets *fan_structure;
+
+	int num_temp_sensors;
+	int temp_sensor_start_offset;
+	int num_virtual_temp_sensors;
+	int virtual_temp_sensor_start_offset;
+	int num_calc_virt_temp_sensors;
+	int calc_virt_temp_sensor_start_offset;
+	int num_aquabus_temp_sensors;
+	int aquabus_temp_sensor_start_offset;
+
+	int num_flow_sensors;
+	u8 flow_sensors_start_offset;
+	int num_aquabus_flow_sensors;
+	u8 aquabus_flow_sensors_start_offset;
+};
+
+static const struct aqc_device_desc aqc_aquaero_desc = {
+	.serial_number_start_offset = AQUAERO_SERIAL_START,
+	.firmware_version_offset = AQUAERO_FIRMWARE_VERSION,
+	.num_fans = AQUAERO_NUM_FANS,
+	.fan_sensor_offsets = aquaero_sensor_fan_offsets,
+	.fan_structure = &aqc_aquaero_fan_structure,
+	.num_temp_sensors = AQUAERO_NUM_SENSORS,
+	.temp_sensor_start_offset = AQUAERO_SENSOR_START,
+	.num_virtual_temp_sensors = AQUAERO_NUM_VIRTUAL_SENSORS,
+	.virtual_temp_sensor_start_offset = AQUAERO_VIRTUAL_SENSOR_START,
+	.num_calc_virt_temp_sensors = AQUAERO_NUM_CALC_VIRTUAL_SENSORS,
+	.calc_virt_temp_sensor_start_offset = AQUAERO_CALC_VIRTUAL_SENSOR_START,
+	.num_aquabus_temp_sensors = AQUAERO_NUM_AQUABUS_SENSORS,
+	.aquabus_temp_sensor_start_offset = AQUAERO_AQUABUS_SENSOR_START,
+	.num_flow_sensors = AQUAERO_NUM_FLOW_SENSORS,
+	.flow_sensors_start_offset = AQUAERO_FLOW_SENSORS_START,
+	.num_aquabus_flow_sensors = AQUAERO_NUM_AQUABUS_FLOW_SENSORS,
+	.aquabus_flow_sensors_start_offset = AQUAERO_AQUABUS_FLOW_SENSORS_START,
+};
+
+static const struct aqc_device_desc aqc_d5next_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.power_cycle_count_offset = AQC_POWER_CYCLES,
+	.num_fans = D5NEXT_NUM_FANS,
+	.fan_sensor_offsets = d5next_sensor_fan_offsets,
+	.fan_structure = &aqc_general_fan_structure,
+	.num_temp_sensors = D5NEXT_NUM_SENSORS,
+	.temp_sensor_start_offset = D5NEXT_COOLANT_TEMP,
+	.num_virtual_temp_sensors = D5NEXT_NUM_VIRTUAL_SENSORS,
+	.virtual_temp_sensor_start_offset = D5NEXT_VIRTUAL_SENSORS_START,
+};
+
+static const struct aqc_device_desc aqc_farbwerk_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.fan_structure = &aqc_general_fan_structure,
+	.num_temp_sensors = FARBWERK_NUM_SENSORS,
+	.temp_sensor_start_offset = FARBWERK_SENSOR_START,
+};
+
+static const struct aqc_device_desc aqc_farbwerk360_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.fan_structure = &aqc_general_fan_structure,
+	.num_temp_sensors = FARBWERK360_NUM_SENSORS,
+	.temp_sensor_start_offset = FARBWERK360_SENSOR_START,
+	.num_virtual_temp_sensors = FARBWERK360_NUM_VIRTUAL_SENSORS,
+	.virtual_temp_sensor_start_offset = FARBWERK360_VIRTUAL_SENSORS_START,
+};
+
+static const struct aqc_device_desc aqc_octo_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.power_cycle_count_offset = AQC_POWER_CYCLES,
+	.num_fans = OCTO_NUM_FANS,
+	.fan_sensor_offsets = octo_sensor_fan_offsets,
+	.fan_structure = &aqc_general_fan_structure,
+	.num_temp_sensors = OCTO_NUM_SENSORS,
+	.temp_sensor_start_offset = OCTO_SENSOR_START,
+	.num_virtual_temp_sensors = OCTO_NUM_VIRTUAL_SENSORS,
+	.virtual_temp_sensor_start_offset = OCTO_VIRTUAL_SENSORS_START,
+	.num_flow_sensors = OCTO_NUM_FLOW_SENSORS,
+	.flow_sensors_start_offset = OCTO_FLOW_SENSOR_OFFSET,
+};
+
+static const struct aqc_device_desc aqc_quadro_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.power_cycle_count_offset = AQC_POWER_CYCLES,
+	.num_fans = QUADRO_NUM_FANS,
+	.fan_sensor_offsets = quadro_sensor_fan_offsets,
+	.fan_structure = &aqc_general_fan_structure,
+	.num_temp_sensors = QUADRO_NUM_SENSORS,
+	.temp_sensor_start_offset = QUADRO_SENSOR_START,
+	.num_virtual_temp_sensors = QUADRO_NUM_VIRTUAL_SENSORS,
+	.virtual_temp_sensor_start_offset = QUADRO_VIRTUAL_SENSORS_START,
+	.num_flow_sensors = QUADRO_NUM_FLOW_SENSORS,
+	.flow_sensors_start_offset = QUADRO_FLOW_SENSOR_OFFSET,
+};
+
+static const struct aqc_device_desc aqc_highflownext_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.power_cycle_count_offset = AQC_POWER_CYCLES,
+	.fan_structure = &aqc_general_fan_structure,
+	.num_temp_sensors = HIGHFLOWNEXT_NUM_SENSORS,
+	.temp_sensor_start_offset = HIGHFLOWNEXT_SENSOR_START,
+	.num_flow_sensors = HIGHFLOWNEXT_NUM_FLOW_SENSORS,
+	.flow_sensors_start_offset = HIGHFLOWNEXT_FLOW,
+};
+
+static const struct aqc_device_desc aqc_leakshield_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.fan_structure = &aqc_general_fan_structure,
+	.num_temp_sensors = LEAKSHIELD_NUM_SENSORS,
+	.temp_sensor_start_offset = LEAKSHIELD_TEMPERATURE_1,
+};
+
+static const struct aqc_device_desc aqc_aquastreamxt_desc = {
+	.serial_number_start_offset = AQUASTREAMXT_SERIAL_START,
+	.firmware_version_offset = AQUASTREAMXT_FIRMWARE_VERSION,
+	.num_fans = AQUASTREAMXT_NUM_FANS,
+	.fan_sensor_offsets = aquastreamxt_sensor_fan_offsets,
+	.num_temp_sensors = AQUASTREAMXT_NUM_SENSORS,
+	.temp_sensor_start_offset = AQUASTREAMXT_SENSOR_START,
+};
+
+static const struct aqc_device_desc aqc_aquastreamult_desc = {
+	.serial_number_start_offset = AQC_SERIAL_START,
+	.firmware_version_offset = AQC_FIRMWARE_VERSION,
+	.num_fans = AQUASTREAMULT_NUM_FANS,
+	.fan_sensor_offsets = aquastreamult_sensor_fan_offsets,
+	.fan_structure = &aqc_aquastreamult_fan_structure,
+	.num_temp_sensors = AQUASTREAMULT_NUM_SENSORS,
+	.temp_sensor_start_offset = AQUASTREAMULT_SENSOR_START,
+};
+
+static const struct aqc_device_desc aqc_poweradjust3_desc = {
+	.serial_number_start_offset = POWERADJUST3_SERIAL_START,
+	.firmware_version_offset = POWERADJUST3_FIRMWARE_VERSION,
+	.num_fans = POWERADJUST3_NUM_FANS,
+	.num_temp_sensors = POWERADJUST3_NUM_SENSORS,
+	.temp_sensor_start_offset = POWERADJUST3_SENSOR_START,
+	.num_flow_sensors = POWERADJUST3_NUM_FLOW_SENSORS,
+	.flow_sensors_start_offset = POWERADJUST3_FLOW_SENSOR_OFFSET,
+};
+
+static const struct aqc_device_desc aqc_highflow_desc = {
+	.serial_number_start_offset = HIGHFLOW_SERIAL_START,
+	.firmware_version_offset = HIGHFLOW_FIRMWARE_VERSION,
+	.num_temp_sensors = HIGHFLOW_NUM_SENSORS,
+	.temp_sensor_start_offset = HIGHFLOW_SENSOR_START,
+	.num_flow_sensors = HIGHFLOW_NUM_FLOW_SENSORS,
+	.flow_sensors_start_offset = HIGHFLOW_FLOW_SENSOR_OFFSET,
+};
+
+struct aqc_pwm_ramp {
+	unsigned int rate;	/* In PWM units per second, 0 if disabled */
+	int current_pwm;	/* Last written step, -1 if not known yet */
+	int target_pwm;
+	bool active;
+};
+
+/* Rate of change of a sensor, as an exponentially weighted average */
+struct aqc_trend {
+	s32 last;
+	s32 rate;	/* Per minute */
+	bool valid;	/* Set once the rate is based on two consecutive readings */
+};
+
+/* Running history of a sensor since probe or the last reset */
+struct aqc_history {
+	s32 lowest;
+	s32 highest;
+	s64 sum;
+	u32 count;	/* Number of readings in sum, 0 if the history is empty */
+};
+
+/*
+ * Energy in uJ outgrows a 32-bit long after about 2 kJ, so it's exposed through the 64-bit
+ * energy attribute where the hwmon core has one, and saturates otherwise
+ */
+#if KERNEL_VERSION(6, 16, 0) <= LINUX_VERSION_CODE
+#define AQC_HWMON_ENERGY	hwmon_energy64
+#else
+#define AQC_HWMON_ENERGY	hwmon_energy
+#endif
+
+/* Reading integrated over time, such as energy from power or volume from flow */
+struct aqc_integral {
+	u64 total;	/* In reading units times ms */
+	s32 last;	/* Last reading, -ENODATA if it was missing, unused before the 2nd report */
+};
+
+struct aqc_profile_slot {
+	char name[AQC_PROFILE_NAME_LEN];
+	u8 *report;	/* Allocated on first save, buffer_size long */
+	bool valid;
+};
+
+struct aqc_ring;
+
+/* A sensor reading that is part of every sample, as its hwmon type and channel */
+struct aqc_sample_chan {
+	enum hwmon_sensor_types type;
+	int channel;
+};
+
 struct aqc_data {
 	struct hid_device *hdev;
 	struct device *hwmon_dev;
+	struct hwmon_chip_info chip_info;	/* With channels trimmed to the device */
 	struct dentry *debugfs;
+
+	/* Readings of the device that make up a sample, in order */
+	struct aqc_sample_chan *sample_chans;
+	int num_sample_chans;
+
+	struct aqc_ring *ring;
+
+#ifdef AQC_IIO_BUFFER
+	struct iio_dev *indio_dev;
+	s32 *iio_scan;	/* Sample, followed by an aligned timestamp */
+	const struct iio_chan_spec *iio_chans;
+	int iio_num_chans;	/* Without the timestamp */
+#endif
 	struct mutex mutex;	/* Used for locking access when reading and writing PWM values */
 	enum kinds kind;
 	const char *name;
-	const struct attribute_group *groups[8];	/* For max 8 fans */
+	const struct attribute_group *groups[16];
 
 	int status_report_id;	/* Used for legacy devices, report is stored in buffer */
 	int ctrl_report_id;
@@ -721,7 +1098,57 @@ struct aqc_data {
 	u8 *secondary_ctrl_report;
 
 	ktime_t last_ctrl_report_op;
+	bool last_ctrl_report_write;	/* Last operation sent a report to the device */
 	int ctrl_report_delay;	/* Delay between two ctrl report operations, in ms */
+	int ctrl_report_write_delay;	/* Default delay of the device, kept after writes */
+	struct work_struct ctrl_report_calibration_work;
+	/* Control report requests made and how many of them failed, protected by mutex */
+	unsigned long ctrl_report_requests;
+	unsigned long ctrl_report_errors;
+	unsigned long ctrl_report_retries;
+	/* Control report link state, protected by mutex. link_health is also read without it */
+	enum aqc_link_health link_health;
+	int ctrl_report_failures;	/* Requests failed in a row, after retrying */
+	unsigned long ctrl_report_probed;	/* Last request made while the link was down */
+	bool ctrl_report_calibrating;	/* Calibration needs to see the failures */
+	/* Driver owned fields of the last control report seen or sent, to notice hidraw writes */
+	int ctrl_report_pwm[AQC_MAX_PWM_CHANNELS];
+	int ctrl_report_profile;
+	bool ctrl_report_tracked;
+	unsigned long ctrl_report_conflicts;
+	unsigned long ctrl_lease_expires;	/* While set, only hidraw users may send reports */
+	/* If set, PWM writes skip the save report until commit is written to */
+	bool pwm_volatile;
+	bool ctrl_report_unsaved;	/* Protected by mutex */
+
+	/* Virtual sensor values to be sent, coalesced by virt_sensors_work */
+	u8 *virt_sensors_buffer;	/* Protected by mutex */
+	unsigned long virt_sensors_sent;
+	struct delayed_work virt_sensors_work;
+
+	/*
+	 * Idle mode, where idle_work closes the input stream after idle_timeout seconds
+	 * without reads or consumers of pushed samples. Protected by idle_mutex
+	 */
+	struct mutex idle_mutex;	/* Serializes opening and closing the device */
+	unsigned int idle_timeout;	/* In seconds, 0 if disabled */
+	bool idle;
+	int idle_holders;	/* Enabled IIO buffers and open ring files */
+	unsigned long last_access;
+	struct delayed_work idle_work;
+	struct completion report_received;	/* Reinitialized when reopening */
+	/* Interval to the next report isn't meaningful, set outside of the report path */
+	bool report_stream_resumed;
+
+	/* PWM ramps, stepped towards their targets by pwm_ramp_work */
+	struct aqc_pwm_ramp pwm_ramps[AQC_MAX_PWM_CHANNELS];
+	spinlock_t pwm_ramp_lock;	/* Protects pwm_ramps */
+	struct delayed_work pwm_ramp_work;
+	int pwm_ramp_failures;	/* Steps in a row that failed, protected by mutex */
+
+	/* Saved control report images, protected by mutex */
+	struct aqc_profile_slot profiles[AQC_NUM_PROFILE_SLOTS];
+	int active_profile;	/* Index of the last applied slot, -1 if none */
 
 	int buffer_size;
 	/*
@@ -733,25 +1160,13 @@ struct aqc_data {
 	int checksum_length;
 	int checksum_offset;
 
-	int num_fans;
-	u16 *fan_sensor_offsets;
+	/* Sensor report layout of the model */
+	const struct aqc_device_desc *desc;
+
 	u16 *fan_ctrl_offsets;
-	int num_temp_sensors;
-	int temp_sensor_start_offset;
-	int num_virtual_temp_sensors;
-	int virtual_temp_sensor_start_offset;
-	int num_calc_virt_temp_sensors;
-	int calc_virt_temp_sensor_start_offset;
-	int num_aquabus_temp_sensors;
-	int aquabus_temp_sensor_start_offset;
 	u16 temp_ctrl_offset;
-	u16 power_cycle_count_offset;
-	int num_flow_sensors;
-	u8 flow_sensors_start_offset;
-	int num_aquabus_flow_sensors;
-	u8 aquabus_flow_sensors_start_offset;
 	u8 flow_pulses_ctrl_offset;
-	struct aqc_fan_structure_offsets *fan_structure;
+	u16 profile_ctrl_offset;
 	u8 *fan_curve_min_power_offsets;
 	u8 *fan_curve_max_power_offsets;
 	/* Used for both "hold min power" and "start boost" parameters */
@@ -765,9 +1180,7 @@ struct aqc_data {
 	struct completion aquaero_sensor_report_received;
 
 	/* General info, available across all devices */
-	u8 serial_number_start_offset;
 	u32 serial_number[2];
-	u8 firmware_version_offset;
 	u16 firmware_version;
 
 	/* How many times the device was powered on */
@@ -778,17 +1191,22 @@ struct aqc_data {
 	u32 total_uptime;
 
 	/*
-	 * Sensor values. temp_input has a maximum of 4 physical + 16 virtual + 20 aquabus,
-	 * or 8 physical + 12 virtual + 20 aquabus sensors, depending on the device
+	 * Sensor values, allocated for the channels of the device. temp_input has a maximum
+	 * of 4 physical + 16 virtual + 20 aquabus, or 8 physical + 12 virtual + 20 aquabus
+	 * sensors, and speed_input of 8 physical + 12 aquabus, depending on the device.
+	 * Power, voltage and current share one count, as they mostly come from the fans
 	 */
-	s32 temp_input[40];
-	s32 speed_input[20];	/* Max 8 physical + 12 aquabus */
-	u32 speed_input_min[20];
+	int num_temp_channels;
+	int num_speed_channels;
+	int num_power_channels;
+	s32 *temp_input;
+	s32 *speed_input;
+	u32 *speed_input_min;
 	u32 speed_input_target[1];
-	u32 speed_input_max[20];
-	u32 power_input[8];
-	u16 voltage_input[8];
-	u16 current_input[8];
+	u32 *speed_input_max;
+	u32 *power_input;
+	u16 *voltage_input;
+	u16 *current_input;
 
 	/* Label values */
 	const char *const *temp_label;
@@ -801,6 +1219,24 @@ struct aqc_data {
 	const char *const *current_label;
 
 	unsigned long updated;
+
+	/* Trends, updated with every sensor report */
+	ktime_t last_report;
+	struct aqc_trend *temp_trend;
+	struct aqc_trend *speed_trend;
+
+	/* Sensor history, updated with every sensor report */
+	spinlock_t history_lock;	/* Protects history, integrals and report statistics */
+	struct aqc_history *temp_history;
+	struct aqc_history *speed_history;
+	struct aqc_history *power_history;
+	struct aqc_integral *energy;	/* In nJ */
+	struct aqc_integral *volume;	/* In dL/h times ms */
+
+	/* Sensor report statistics, for devices that push reports */
+	unsigned long reports_received;
+	unsigned long report_gaps;	/* Intervals over AQC_REPORT_GAP_FACTOR periods */
+	unsigned long report_jitter[AQC_REPORT_JITTER_BUCKETS];
 };
 
 /* Converts from centi-percent */
@@ -856,159 +1292,771 @@ static int aqc_aquastreamxt_convert_fan_rpm(u16 val)
 	return 0;
 }
 
+/*
+ * Whether user space has the hidraw node of the device open, and may send reports of its own.
+ * This is a best-effort heuristic that peeks at the private state of the hidraw core without
+ * its locks, so the answer may be stale by the time it's used. It only decides how long to
+ * wait between requests, never whether a request is made
+ */
+static bool aqc_hidraw_open(struct aqc_data *priv)
+{
+#if IS_ENABLED(CONFIG_HIDRAW)
+	struct hidraw *hidraw = priv->hdev->hidraw;
+
+	return hidraw && READ_ONCE(hidraw->open) > 0;
+#else
+	return false;
+#endif
+}
+
 static void aqc_delay_ctrl_report(struct aqc_data *priv)
 {
+	int delay = priv->ctrl_report_delay;
+
+	/*
+	 * Requests made through hidraw are not spaced out by the driver, so the calibrated
+	 * delay may be too short while the node is open. Fall back to the default one then
+	 */
+	if (aqc_hidraw_open(priv))
+		delay = max(delay, CTRL_REPORT_DELAY);
+
+	/*
+	 * Calibration only measures how fast the device answers reads. Writes make it update
+	 * its settings, so give it the default delay of the device after them
+	 */
+	if (priv->last_ctrl_report_write)
+		delay = max(delay, priv->ctrl_report_write_delay);
+
 	/*
 	 * If previous read or write is too close to this one, delay the current operation
 	 * to give the device enough time to process the previous one.
 	 */
-	if (priv->ctrl_report_delay) {
+	if (delay) {
 		s64 delta = ktime_ms_delta(ktime_get(), priv->last_ctrl_report_op);
 
-		if (delta < priv->ctrl_report_delay)
-			msleep(priv->ctrl_report_delay - delta);
+		if (delta < delay)
+			msleep(delay - delta);
 	}
 }
 
 /* Expects the mutex to be locked */
-static int aqc_get_ctrl_data(struct aqc_data *priv)
+static bool aqc_ctrl_report_leased(struct aqc_data *priv)
 {
-	int ret;
+	return priv->ctrl_lease_expires && time_before(jiffies, priv->ctrl_lease_expires);
+}
 
-	aqc_delay_ctrl_report(priv);
+/*
+ * Errors a busy hub or a device still processing the previous request can cause. A timeout
+ * already took seconds and usually means the device stopped answering, so it counts as a
+ * failure right away instead of being retried
+ */
+static bool aqc_ctrl_error_is_transient(int err)
+{
+	return err == -EPIPE || err == -EIO || err == -EPROTO;
+}
 
-	memset(priv->buffer, 0x00, priv->buffer_size);
-	ret = hid_hw_raw_request(priv->hdev, priv->ctrl_report_id, priv->buffer, priv->buffer_size,
-				 HID_FEATURE_REPORT, HID_REQ_GET_REPORT);
-	if (ret < 0)
-		ret = -ENODATA;
+/*
+ * Sends a control feature report request and accounts for it. Transient errors are
+ * retried with backoff, and the link health is updated from the outcome. While the
+ * link is failed, requests return -EIO right away, apart from a single attempt per
+ * CTRL_REPORT_PROBE_INTERVAL that brings the link back if it succeeds. While a
+ * lease is granted to hidraw users, requests fail with -EBUSY.
+ * Expects the mutex to be locked
+ */
+static int aqc_ctrl_request(struct aqc_data *priv, u8 report_id, u8 *buf, size_t len,
+			    enum hid_class_request reqtype)
+{
+	int ret, retries = CTRL_REPORT_RETRIES, attempt = 0;
+	u8 *orig = NULL;
 
-	priv->last_ctrl_report_op = ktime_get();
+	if (aqc_ctrl_report_leased(priv))
+		return -EBUSY;
+
+	if (priv->link_health == AQC_LINK_FAILED) {
+		if (time_before(jiffies, priv->ctrl_report_probed + CTRL_REPORT_PROBE_INTERVAL))
+			return -EIO;
+
+		priv->ctrl_report_probed = jiffies;
+		retries = 0;
+	}
+
+	if (priv->ctrl_report_calibrating)
+		retries = 0;
+
+	/* Get requests overwrite the buffer, so keep what is being sent for retries */
+	if (retries && reqtype == HID_REQ_SET_REPORT) {
+		orig = kmemdup(buf, len, GFP_KERNEL);
+		if (!orig)
+			return -ENOMEM;
+	}
+
+	for (;;) {
+		ret = hid_hw_raw_request(priv->hdev, report_id, buf, len, HID_FEATURE_REPORT,
+					 reqtype);
+
+		priv->ctrl_report_requests++;
+		if (ret >= 0)
+			break;
+
+		priv->ctrl_report_errors++;
+		if (attempt == retries || !aqc_ctrl_error_is_transient(ret))
+			break;
+
+		msleep(priv->ctrl_report_delay + (CTRL_REPORT_RETRY_BACKOFF << attempt));
+		if (orig)
+			memcpy(buf, orig, len);
+
+		attempt++;
+		priv->ctrl_report_retries++;
+	}
+
+	kfree(orig);
+
+	if (priv->ctrl_report_calibrating)
+		return ret;
+
+	if (ret >= 0) {
+		priv->ctrl_report_failures = 0;
+		WRITE_ONCE(priv->link_health, attempt ? AQC_LINK_DEGRADED : AQC_LINK_OK);
+	} else if (++priv->ctrl_report_failures >= CTRL_REPORT_FAIL_THRESHOLD) {
+		if (priv->link_health != AQC_LINK_FAILED)
+			hid_warn(priv->hdev, "control report link failed (%d)\n", ret);
+		WRITE_ONCE(priv->link_health, AQC_LINK_FAILED);
+		priv->ctrl_report_probed = jiffies;
+	} else {
+		WRITE_ONCE(priv->link_health, AQC_LINK_DEGRADED);
+	}
 
 	return ret;
 }
 
-/* Expects the mutex to be locked */
-static int aqc_send_ctrl_data(struct aqc_data *priv)
+/* Reads the PWM value of a channel from the control buffer, expects the mutex to be locked */
+static int aqc_buffer_get_pwm(struct aqc_data *priv, int channel)
 {
-	int ret;
-	u16 checksum;
+	int val;
 
-	aqc_delay_ctrl_report(priv);
+	switch (priv->kind) {
+	case aquaero:
+		val = get_unaligned_be16(priv->buffer + AQUAERO_CTRL_PRESET_START +
+					 channel * AQUAERO_CTRL_PRESET_SIZE);
+		return aqc_percent_to_pwm(val);
+	case aquastreamxt:
+		if (channel == 0) {
+			val = get_unaligned_le16(priv->buffer + priv->fan_ctrl_offsets[channel]);
+			val = aqc_aquastreamxt_convert_pump_rpm(val);
+			return aqc_aquastreamxt_rpm_to_pwm(val);
+		}
+
+		return priv->buffer[priv->fan_ctrl_offsets[channel]];
+	default:
+		val = get_unaligned_be16(priv->buffer + priv->fan_ctrl_offsets[channel] +
+					 AQC_FAN_CTRL_PWM_OFFSET);
+		return aqc_percent_to_pwm(val);
+	}
+}
 
-	/* Checksum is not needed for Aquaero and Aquastream XT */
-	if (priv->kind != aquaero && priv->kind != aquastreamxt) {
-		/* Init and xorout value for CRC-16/USB is 0xffff */
-		checksum =
-		    crc16(0xffff, priv->buffer + priv->checksum_start, priv->checksum_length);
-		checksum ^= 0xffff;
+/*
+ * Compares the fields the driver writes on its own, fan PWM values and the profile, to the
+ * last control report it saw. Changes mean someone else wrote to them through hidraw, so
+ * drop the state derived from the old values: ramps on the channels that were changed and
+ * the applied profile slot. Other fields are left alone, as the device or aquasuite can
+ * update them without touching what the driver controls. Expects the mutex to be locked
+ */
+static void aqc_check_ctrl_report(struct aqc_data *priv)
+{
+	bool changed = false;
+	int i, val;
+
+	for (i = 0; i < priv->desc->num_fans; i++) {
+		val = aqc_buffer_get_pwm(priv, i);
+		if (val == priv->ctrl_report_pwm[i])
+			continue;
+
+		/* The other writer's PWM value wins over an ongoing ramp */
+		spin_lock(&priv->pwm_ramp_lock);
+		priv->pwm_ramps[i].active = false;
+		priv->pwm_ramps[i].current_pwm = -1;
+		spin_unlock(&priv->pwm_ramp_lock);
+		changed = true;
+	}
 
-		/* Place the new checksum at the end of the report */
-		put_unaligned_be16(checksum, priv->buffer + priv->checksum_offset);
+	if (priv->profile_ctrl_offset &&
+	    priv->buffer[priv->profile_ctrl_offset] != priv->ctrl_report_profile) {
+		priv->active_profile = -1;
+		changed = true;
 	}
 
-	/* Send the patched up report back to the device */
-	ret = hid_hw_raw_request(priv->hdev, priv->ctrl_report_id, priv->buffer, priv->buffer_size,
-				 HID_FEATURE_REPORT, HID_REQ_SET_REPORT);
-	if (ret < 0)
-		goto record_access_and_ret;
+	if (changed) {
+		priv->ctrl_report_conflicts++;
+		hid_dbg(priv->hdev, "control report changed outside of the driver\n");
+	}
+}
 
-	/* The official software sends this report after every change, so do it here as well */
-	ret =
-	    hid_hw_raw_request(priv->hdev, priv->secondary_ctrl_report_id,
-			       priv->secondary_ctrl_report, priv->secondary_ctrl_report_size,
-			       HID_FEATURE_REPORT, HID_REQ_SET_REPORT);
-record_access_and_ret:
-	priv->last_ctrl_report_op = ktime_get();
+/* Remembers the control report in the buffer as the current one, expects the mutex to be locked */
+static void aqc_track_ctrl_report(struct aqc_data *priv, bool check)
+{
+	int i;
 
-	return ret;
+	if (check && priv->ctrl_report_tracked)
+		aqc_check_ctrl_report(priv);
+
+	for (i = 0; i < priv->desc->num_fans; i++)
+		priv->ctrl_report_pwm[i] = aqc_buffer_get_pwm(priv, i);
+	if (priv->profile_ctrl_offset)
+		priv->ctrl_report_profile = priv->buffer[priv->profile_ctrl_offset];
+	priv->ctrl_report_tracked = true;
 }
 
-/* Refreshes the control buffer and stores value at offset in val */
-static int aqc_get_ctrl_val(struct aqc_data *priv, int offset, long *val, int type)
+/* Expects the mutex to be locked */
+static int aqc_get_ctrl_data(struct aqc_data *priv)
 {
 	int ret;
 
-	mutex_lock(&priv->mutex);
+	aqc_delay_ctrl_report(priv);
 
-	ret = aqc_get_ctrl_data(priv);
-	if (ret < 0)
-		goto unlock_and_return;
+	memset(priv->buffer, 0x00, priv->buffer_size);
+	ret = aqc_ctrl_request(priv, priv->ctrl_report_id, priv->buffer, priv->buffer_size,
+			       HID_REQ_GET_REPORT);
+	/* Readers get no data, except while the report is leased, so they know to back off */
+	if (ret < 0 && ret != -EBUSY)
+		ret = -ENODATA;
+	else if (ret >= 0)
+		aqc_track_ctrl_report(priv, true);
 
-	switch (type) {
-	case AQC_LE16:
-		*val = (s16)get_unaligned_le16(priv->buffer + offset);
-		break;
-	case AQC_BE16:
-		*val = (s16)get_unaligned_be16(priv->buffer + offset);
-		break;
-	case AQC_8:
-		*val = priv->buffer[offset];
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
+	priv->last_ctrl_report_op = ktime_get();
+	priv->last_ctrl_report_write = false;
 
-unlock_and_return:
-	mutex_unlock(&priv->mutex);
 	return ret;
 }
 
-static int aqc_set_buffer_val(u8 *buffer, int offset, long val, int type)
+/* Devices whose settings can be read and written through a control report */
+static bool aqc_has_ctrl_report(struct aqc_data *priv)
 {
-	switch (type) {
-	case AQC_LE16:
-		put_unaligned_le16((u16)val, buffer + offset);
-		return 0;
-	case AQC_BE16:
-		put_unaligned_be16((u16)val, buffer + offset);
-		return 0;
-	case AQC_8:
-		buffer[offset] = (u8)val;
-		return 0;
+	switch (priv->kind) {
+	case aquaero:
+	case d5next:
+	case farbwerk360:
+	case octo:
+	case quadro:
+	case aquastreamxt:
+		return true;
 	default:
-		return -EINVAL;
+		return false;
 	}
 }
 
-/* Refreshes the control buffer, updates values at offsets and writes buffer to device */
-static int aqc_set_ctrl_vals(struct aqc_data *priv, int *offsets, long *values, int *types, int len)
+/* Checksum is not needed for Aquaero and Aquastream XT */
+static bool aqc_ctrl_report_has_checksum(struct aqc_data *priv)
 {
-	int ret, i;
+	return priv->kind != aquaero && priv->kind != aquastreamxt;
+}
 
-	mutex_lock(&priv->mutex);
+static u16 aqc_ctrl_report_checksum(struct aqc_data *priv, u8 *report)
+{
+	/* Init and xorout value for CRC-16/USB is 0xffff */
+	return crc16(0xffff, report + priv->checksum_start, priv->checksum_length) ^ 0xffff;
+}
 
-	ret = aqc_get_ctrl_data(priv);
+/* Checks that a control report image belongs to this device and is intact */
+static bool aqc_ctrl_report_valid(struct aqc_data *priv, u8 *report)
+{
+	if (report[0] != priv->ctrl_report_id)
+		return false;
+
+	if (!aqc_ctrl_report_has_checksum(priv))
+		return true;
+
+	return aqc_ctrl_report_checksum(priv, report) ==
+	    get_unaligned_be16(report + priv->checksum_offset);
+}
+
+/*
+ * Writes the control buffer to the device. If save is false, the save report is not
+ * sent, so the device applies the new settings without persisting them.
+ * Expects the mutex to be locked
+ */
+static int aqc_send_ctrl_data(struct aqc_data *priv, bool save)
+{
+	int ret;
+
+	aqc_delay_ctrl_report(priv);
+
+	/* Place the new checksum at the end of the report */
+	if (aqc_ctrl_report_has_checksum(priv))
+		put_unaligned_be16(aqc_ctrl_report_checksum(priv, priv->buffer),
+				   priv->buffer + priv->checksum_offset);
+
+	/* Send the patched up report back to the device */
+	ret = aqc_ctrl_request(priv, priv->ctrl_report_id, priv->buffer, priv->buffer_size,
+			       HID_REQ_SET_REPORT);
 	if (ret < 0)
-		goto unlock_and_return;
+		goto record_access_and_ret;
 
-	for (i = 0; i < len; i++) {
-		ret = aqc_set_buffer_val(priv->buffer, offsets[i], values[i], types[i]);
-		if (ret < 0)
-			goto unlock_and_return;
+	aqc_track_ctrl_report(priv, false);
+
+	if (!save) {
+		priv->ctrl_report_unsaved = true;
+		goto record_access_and_ret;
 	}
 
-	ret = aqc_send_ctrl_data(priv);
+	/* The official software sends this report after every change, so do it here as well */
+	ret = aqc_ctrl_request(priv, priv->secondary_ctrl_report_id, priv->secondary_ctrl_report,
+			       priv->secondary_ctrl_report_size, HID_REQ_SET_REPORT);
+	if (ret >= 0)
+		priv->ctrl_report_unsaved = false;
+record_access_and_ret:
+	priv->last_ctrl_report_op = ktime_get();
+	priv->last_ctrl_report_write = true;
 
-unlock_and_return:
-	mutex_unlock(&priv->mutex);
 	return ret;
 }
 
+/* Makes the device persist settings sent without the save report, expects the mutex to be locked */
+static int aqc_save_ctrl_data(struct aqc_data *priv)
+{
+	int ret;
+
+	aqc_delay_ctrl_report(priv);
+
+	ret = aqc_ctrl_request(priv, priv->secondary_ctrl_report_id, priv->secondary_ctrl_report,
+			       priv->secondary_ctrl_report_size, HID_REQ_SET_REPORT);
+	if (ret >= 0)
+		priv->ctrl_report_unsaved = false;
+
+	priv->last_ctrl_report_op = ktime_get();
+	priv->last_ctrl_report_write = true;
+
+	return ret;
+}
+
+/*
+ * Finds the shortest spacing between control report operations that the device
+ * reliably handles, by repeatedly requesting the control report with decreasing
+ * delays and comparing it to a reference read with the default delay. The chosen
+ * delay gets a safety margin and only spaces out reads, as writes are always
+ * followed by the default delay of the device. Expects the mutex to be locked
+ */
+static int aqc_calibrate_ctrl_report_delay(struct aqc_data *priv)
+{
+	int ret, i, round, delay = -1;
+	u8 *reference;
+
+	priv->ctrl_report_delay = CTRL_REPORT_DELAY;
+	ret = aqc_get_ctrl_data(priv);
+	if (ret < 0)
+		return ret;
+
+	reference = kmemdup(priv->buffer, priv->buffer_size, GFP_KERNEL);
+	if (!reference)
+		return -ENOMEM;
+
+	/* Failures are expected here and tell the delay is too short, so don't retry them */
+	priv->ctrl_report_calibrating = true;
+
+	for (i = 0; i < ARRAY_SIZE(aqc_ctrl_report_delay_steps); i++) {
+		priv->ctrl_report_delay = aqc_ctrl_report_delay_steps[i];
+
+		for (round = 0; round < CTRL_REPORT_CALIBRATION_ROUNDS; round++) {
+			ret = aqc_get_ctrl_data(priv);
+			if (ret < 0 || memcmp(priv->buffer, reference, priv->buffer_size) != 0)
+				break;
+		}
+
+		if (round < CTRL_REPORT_CALIBRATION_ROUNDS)
+			break;
+
+		delay = aqc_ctrl_report_delay_steps[i];
+	}
+
+	priv->ctrl_report_calibrating = false;
+	kfree(reference);
+
+	if (delay < 0) {
+		priv->ctrl_report_delay = priv->ctrl_report_write_delay;
+		return -EIO;
+	}
+
+	/* Devices that work without any spacing by default may keep doing so */
+	delay += delay / 4;
+	if (priv->ctrl_report_write_delay)
+		delay = clamp(delay, CTRL_REPORT_DELAY_MIN, CTRL_REPORT_DELAY);
+	priv->ctrl_report_delay = delay;
+
+	/* Give the device time to recover from the last, possibly too fast, request */
+	msleep(CTRL_REPORT_DELAY);
+
+	return 0;
+}
+
+static void aqc_ctrl_report_calibration_work(struct work_struct *work)
+{
+	struct aqc_data *priv = container_of(work, struct aqc_data, ctrl_report_calibration_work);
+	int ret;
+
+	mutex_lock(&priv->mutex);
+	ret = aqc_calibrate_ctrl_report_delay(priv);
+	mutex_unlock(&priv->mutex);
+
+	if (ret < 0)
+		hid_warn(priv->hdev, "control report delay calibration failed (%d)\n", ret);
+}
+
+/* Refreshes the control buffer and stores value at offset in val */
+static int aqc_get_ctrl_val(struct aqc_data *priv, int offset, long *val, int type)
+{
+	int ret;
+
+	mutex_lock(&priv->mutex);
+
+	ret = aqc_get_ctrl_data(priv);
+	if (ret < 0)
+		goto unlock_and_return;
+
+	switch (type) {
+	case AQC_LE16:
+		*val = (s16)get_unaligned_le16(priv->buffer + offset);
+		break;
+	case AQC_BE16:
+		*val = (s16)get_unaligned_be16(priv->buffer + offset);
+		break;
+	case AQC_8:
+		*val = priv->buffer[offset];
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+unlock_and_return:
+	mutex_unlock(&priv->mutex);
+	return ret;
+}
+
+static int aqc_set_buffer_val(u8 *buffer, int offset, long val, int type)
+{
+	switch (type) {
+	case AQC_LE16:
+		put_unaligned_le16((u16)val, buffer + offset);
+		return 0;
+	case AQC_BE16:
+		put_unaligned_be16((u16)val, buffer + offset);
+		return 0;
+	case AQC_8:
+		buffer[offset] = (u8)val;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Refreshes the control buffer, updates values at offsets and writes buffer to device,
+ * followed by the save report if save is true
+ */
+static int aqc_write_ctrl_vals(struct aqc_data *priv, int *offsets, long *values, int *types,
+			       int len, bool save)
+{
+	int ret, i;
+
+	mutex_lock(&priv->mutex);
+
+	ret = aqc_get_ctrl_data(priv);
+	if (ret < 0)
+		goto unlock_and_return;
+
+	for (i = 0; i < len; i++) {
+		ret = aqc_set_buffer_val(priv->buffer, offsets[i], values[i], types[i]);
+		if (ret < 0)
+			goto unlock_and_return;
+	}
+
+	ret = aqc_send_ctrl_data(priv, save);
+
+unlock_and_return:
+	mutex_unlock(&priv->mutex);
+	return ret;
+}
+
+/* Refreshes the control buffer, updates values at offsets and writes buffer to device */
+static int aqc_set_ctrl_vals(struct aqc_data *priv, int *offsets, long *values, int *types, int len)
+{
+	return aqc_write_ctrl_vals(priv, offsets, values, types, len, true);
+}
+
+/* Same as aqc_set_ctrl_vals(), but skips the save report if PWM updates are volatile */
+static int aqc_set_pwm_ctrl_vals(struct aqc_data *priv, int *offsets, long *values, int *types,
+				 int len)
+{
+	return aqc_write_ctrl_vals(priv, offsets, values, types, len, !priv->pwm_volatile);
+}
+
 /* Refreshes the control buffer, updates value at offset and writes buffer to device */
 static int aqc_set_ctrl_val(struct aqc_data *priv, int offset, long val, int type)
 {
 	return aqc_set_ctrl_vals(priv, &offset, &val, &type, 1);
 }
 
+/*
+ * Fills in the control report values that need to be written to set the PWM of a channel.
+ * Returns how many values were filled in, at most AQC_PWM_MAX_CTRL_VALS
+ */
+static int aqc_pwm_to_ctrl_vals(struct aqc_data *priv, int channel, long val, int *offsets,
+				long *values, int *types)
+{
+	int pwm_value;
+
+	switch (priv->kind) {
+	case aquaero:
+		pwm_value = aqc_pwm_to_percent(val);
+		/* Write pwm value to preset corresponding to the channel */
+		offsets[0] = AQUAERO_CTRL_PRESET_START + channel * AQUAERO_CTRL_PRESET_SIZE;
+		values[0] = pwm_value;
+		types[0] = AQC_BE16;
+
+		/* Write preset number in fan control source */
+		offsets[1] = priv->fan_ctrl_offsets[channel] + AQUAERO_FAN_CTRL_SRC_OFFSET;
+		values[1] = AQUAERO_CTRL_PRESET_ID + channel;
+		types[1] = AQC_BE16;
+
+		/* Set minimum power to 0 to allow the fan to turn off */
+		offsets[2] = priv->fan_ctrl_offsets[channel] + AQUAERO_FAN_CTRL_MIN_PWR_OFFSET;
+		values[2] = 0;
+		types[2] = AQC_BE16;
+
+		/* Set maximum power to 100% to allow the fan to reach maximum speed */
+		offsets[3] = priv->fan_ctrl_offsets[channel] + AQUAERO_FAN_CTRL_MAX_PWR_OFFSET;
+		values[3] = aqc_pwm_to_percent(255);
+		types[3] = AQC_BE16;
+
+		return 4;
+	case aquastreamxt:
+		if (channel == 0) {
+			pwm_value = aqc_aquastreamxt_pwm_to_rpm(val);
+			pwm_value = aqc_aquastreamxt_convert_pump_rpm(pwm_value);
+			offsets[0] = priv->fan_ctrl_offsets[channel];
+			values[0] = pwm_value;
+			types[0] = AQC_LE16;
+
+			/* Enable manual speed control */
+			offsets[1] = AQUASTREAMXT_PUMP_MODE_CTRL_OFFSET;
+			values[1] = AQUASTREAMXT_PUMP_MODE_CTRL_MANUAL;
+			types[1] = AQC_8;
+		} else {
+			offsets[0] = priv->fan_ctrl_offsets[channel];
+			values[0] = val;
+			types[0] = AQC_8;
+
+			/* Enable manual speed control */
+			offsets[1] = AQUASTREAMXT_FAN_MODE_CTRL_OFFSET;
+			values[1] = AQUASTREAMXT_FAN_MODE_CTRL_MANUAL;
+			types[1] = AQC_8;
+		}
+
+		return 2;
+	default:
+		offsets[0] = priv->fan_ctrl_offsets[channel] + AQC_FAN_CTRL_PWM_OFFSET;
+		values[0] = aqc_pwm_to_percent(val);
+		types[0] = AQC_BE16;
+
+		return 1;
+	}
+}
+
+/* Refreshes the control buffer and reads PWM values of count channels, starting at channel */
+static int aqc_get_pwm_vals(struct aqc_data *priv, int channel, long *vals, int count)
+{
+	int ret, i;
+
+	mutex_lock(&priv->mutex);
+
+	ret = aqc_get_ctrl_data(priv);
+	if (ret < 0)
+		goto unlock_and_return;
+
+	for (i = 0; i < count; i++)
+		vals[i] = aqc_buffer_get_pwm(priv, channel + i);
+
+unlock_and_return:
+	mutex_unlock(&priv->mutex);
+	return ret;
+}
+
+/* Drops all ramps, leaving the fans at their last written step */
+static void aqc_abort_pwm_ramps(struct aqc_data *priv)
+{
+	int i;
+
+	spin_lock(&priv->pwm_ramp_lock);
+	for (i = 0; i < priv->desc->num_fans; i++) {
+		priv->pwm_ramps[i].active = false;
+		priv->pwm_ramps[i].current_pwm = -1;
+	}
+	spin_unlock(&priv->pwm_ramp_lock);
+}
+
+/*
+ * Moves ramping channels one step closer to their targets, all in one control report write.
+ * A step only counts once the write went through, so a failed one is retried from the same
+ * place on the next run. Ramps are given up on if the device can't be reached, either
+ * because the link failed or the control report is leased, or after too many failed steps
+ */
+static void aqc_pwm_ramp_work(struct work_struct *work)
+{
+	struct aqc_data *priv = container_of(to_delayed_work(work), struct aqc_data,
+					     pwm_ramp_work);
+	int offsets[AQC_MAX_PWM_CHANNELS * AQC_PWM_MAX_CTRL_VALS];
+	long values[AQC_MAX_PWM_CHANNELS * AQC_PWM_MAX_CTRL_VALS];
+	int types[AQC_MAX_PWM_CHANNELS * AQC_PWM_MAX_CTRL_VALS];
+	int steps[AQC_MAX_PWM_CHANNELS];
+	int ret, i, step, pwm, len = 0;
+	struct aqc_pwm_ramp *ramp;
+	bool pending = false;
+
+	mutex_lock(&priv->mutex);
+
+	if (priv->link_health == AQC_LINK_FAILED || aqc_ctrl_report_leased(priv)) {
+		aqc_abort_pwm_ramps(priv);
+		goto unlock_and_reschedule;
+	}
+
+	ret = aqc_get_ctrl_data(priv);
+	if (ret < 0)
+		goto fail_and_reschedule;
+
+	spin_lock(&priv->pwm_ramp_lock);
+	for (i = 0; i < priv->desc->num_fans; i++) {
+		ramp = &priv->pwm_ramps[i];
+		steps[i] = -1;
+		if (!ramp->active)
+			continue;
+
+		pwm = ramp->current_pwm;
+		if (pwm < 0)
+			pwm = aqc_buffer_get_pwm(priv, i);
+
+		step = DIV_ROUND_UP(ramp->rate * AQC_PWM_RAMP_INTERVAL, 1000);
+		if (pwm < ramp->target_pwm)
+			pwm = min(pwm + step, ramp->target_pwm);
+		else
+			pwm = max(pwm - step, ramp->target_pwm);
+
+		if (pwm != ramp->target_pwm)
+			pending = true;
+
+		steps[i] = pwm;
+		len += aqc_pwm_to_ctrl_vals(priv, i, pwm, offsets + len, values + len,
+					    types + len);
+	}
+	spin_unlock(&priv->pwm_ramp_lock);
+
+	if (len == 0)
+		goto unlock_and_reschedule;
+
+	for (i = 0; i < len; i++)
+		aqc_set_buffer_val(priv->buffer, offsets[i], values[i], types[i]);
+
+	/* Intermediate steps are never persisted */
+	ret = aqc_send_ctrl_data(priv, !pending && !priv->pwm_volatile);
+	if (ret < 0)
+		goto fail_and_reschedule;
+
+	priv->pwm_ramp_failures = 0;
+
+	spin_lock(&priv->pwm_ramp_lock);
+	for (i = 0; i < priv->desc->num_fans; i++) {
+		ramp = &priv->pwm_ramps[i];
+		/* Skip ramps that were stopped while the step was being written */
+		if (steps[i] < 0 || !ramp->active)
+			continue;
+
+		if (steps[i] == ramp->target_pwm) {
+			/* Done, the next ramp on this channel starts from the device value */
+			ramp->active = false;
+			ramp->current_pwm = -1;
+		} else {
+			ramp->current_pwm = steps[i];
+		}
+	}
+	spin_unlock(&priv->pwm_ramp_lock);
+	goto unlock_and_reschedule;
+
+fail_and_reschedule:
+	if (++priv->pwm_ramp_failures >= AQC_PWM_RAMP_MAX_FAILURES) {
+		hid_warn(priv->hdev, "dropping PWM ramps after %d failed steps (%d)\n",
+			 priv->pwm_ramp_failures, ret);
+		aqc_abort_pwm_ramps(priv);
+		priv->pwm_ramp_failures = 0;
+	}
+unlock_and_reschedule:
+	mutex_unlock(&priv->mutex);
+
+	/* Keep going while there are steps left, including ones whose write failed */
+	pending = false;
+	spin_lock(&priv->pwm_ramp_lock);
+	for (i = 0; i < priv->desc->num_fans; i++)
+		pending |= priv->pwm_ramps[i].active;
+	spin_unlock(&priv->pwm_ramp_lock);
+
+	if (pending)
+		schedule_delayed_work(&priv->pwm_ramp_work,
+				      msecs_to_jiffies(AQC_PWM_RAMP_INTERVAL));
+}
+
+/* Sets a new ramp target for the channel, the ramp is carried out in the background */
+static void aqc_start_pwm_ramp(struct aqc_data *priv, int channel, long val)
+{
+	spin_lock(&priv->pwm_ramp_lock);
+	priv->pwm_ramps[channel].target_pwm = val;
+	priv->pwm_ramps[channel].active = true;
+	spin_unlock(&priv->pwm_ramp_lock);
+
+	/* Does nothing if a step is already scheduled */
+	schedule_delayed_work(&priv->pwm_ramp_work, 0);
+}
+
+/* Stops a ramp on the channel, for when its PWM was set directly */
+static void aqc_stop_pwm_ramp(struct aqc_data *priv, int channel)
+{
+	spin_lock(&priv->pwm_ramp_lock);
+	priv->pwm_ramps[channel].active = false;
+	priv->pwm_ramps[channel].current_pwm = -1;
+	spin_unlock(&priv->pwm_ramp_lock);
+}
+
+static int aqc_count_visible(const struct aqc_data *priv, enum hwmon_sensor_types type,
+			     u32 attr, int max);
+
 static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u32 attr, int channel)
 {
 	const struct aqc_data *priv = data;
 
 	switch (type) {
+	case hwmon_chip:
+		switch (attr) {
+		/* Only offered if there's a history to reset */
+		case hwmon_chip_temp_reset_history:
+			return aqc_count_visible(priv, hwmon_temp, hwmon_temp_input,
+						 AQC_MAX_TEMP_CHANNELS) ? 0200 : 0;
+		case hwmon_chip_power_reset_history:
+			return aqc_count_visible(priv, hwmon_power, hwmon_power_input,
+						 AQC_MAX_POWER_CHANNELS) ? 0200 : 0;
+		default:
+			break;
+		}
+		break;
 	case hwmon_temp:
-		if (channel < priv->num_temp_sensors) {
+		/* History is available for every temperature reading */
+		switch (attr) {
+		case hwmon_temp_lowest:
+		case hwmon_temp_highest:
+			return aqc_is_visible(data, type, hwmon_temp_input, channel) ? 0444 : 0;
+		case hwmon_temp_reset_history:
+			return aqc_is_visible(data, type, hwmon_temp_input, channel) ? 0200 : 0;
+		default:
+			break;
+		}
+
+		if (channel < priv->desc->num_temp_sensors) {
 			switch (attr) {
 			case hwmon_temp_label:
 			case hwmon_temp_input:
@@ -1017,14 +2065,19 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 				if (priv->temp_ctrl_offset != 0)
 					return 0644;
 				break;
+			case hwmon_temp_max:
+				/* Alarm thresholds of the external and coolant sensors */
+				if (priv->kind == aquastreamxt && channel > 0)
+					return 0644;
+				break;
 			default:
 				break;
 			}
 		}
 
 		if (channel <
-		    priv->num_temp_sensors + priv->num_virtual_temp_sensors +
-		    priv->num_calc_virt_temp_sensors + priv->num_aquabus_temp_sensors)
+		    priv->desc->num_temp_sensors + priv->desc->num_virtual_temp_sensors +
+		    priv->desc->num_calc_virt_temp_sensors + priv->desc->num_aquabus_temp_sensors)
 			switch (attr) {
 			case hwmon_temp_label:
 			case hwmon_temp_input:
@@ -1034,7 +2087,7 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 			}
 		break;
 	case hwmon_pwm:
-		if (priv->fan_ctrl_offsets && channel < priv->num_fans) {
+		if (priv->fan_ctrl_offsets && channel < priv->desc->num_fans) {
 			switch (priv->kind) {
 			case aquaero:
 				switch (attr) {
@@ -1053,6 +2106,10 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 				switch (attr) {
 				case hwmon_pwm_input:
 					return 0644;
+				case hwmon_pwm_enable:
+					if (channel == AQUASTREAMXT_FAN_CHANNEL)
+						return 0644;
+					break;
 				default:
 					break;
 				}
@@ -1111,20 +2168,20 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 			case highflow:
 			case poweradjust3:
 				/* Special case to support flow sensors */
-				if (channel < priv->num_fans +
-				    priv->num_flow_sensors +
-				    priv->num_aquabus_flow_sensors)
+				if (channel < priv->desc->num_fans +
+				    priv->desc->num_flow_sensors +
+				    priv->desc->num_aquabus_flow_sensors)
 					return 0444;
 				break;
 			default:
-				if (channel < priv->num_fans)
+				if (channel < priv->desc->num_fans)
 					return 0444;
 				break;
 			}
 			break;
 		case hwmon_fan_min:
 		case hwmon_fan_max:
-			if (priv->kind == aquaero && channel < priv->num_fans)
+			if (priv->kind == aquaero && channel < priv->desc->num_fans)
 				return 0644;
 			fallthrough;
 		case hwmon_fan_target:
@@ -1134,7 +2191,7 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 			break;
 		case hwmon_fan_pulses:
 			/* Special case for Quadro/Octo flow sensor */
-			if (channel == priv->num_fans) {
+			if (channel == priv->desc->num_fans) {
 				switch (priv->kind) {
 				case quadro:
 				case octo:
@@ -1149,6 +2206,9 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 		}
 		break;
 	case hwmon_power:
+		if (attr == hwmon_power_reset_history)
+			return aqc_is_visible(data, type, hwmon_power_input, channel) ? 0200 : 0;
+
 		switch (priv->kind) {
 		case aquastreamult:
 			/* Special case to support pump and fan power */
@@ -1164,11 +2224,14 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 		case poweradjust3:
 			break;
 		default:
-			if (channel < priv->num_fans)
+			if (channel < priv->desc->num_fans)
 				return 0444;
 			break;
 		}
 		break;
+	case AQC_HWMON_ENERGY:
+		/* Energy is integrated from the power readings */
+		return aqc_is_visible(data, hwmon_power, hwmon_power_input, channel) ? 0444 : 0;
 	case hwmon_curr:
 		switch (priv->kind) {
 		case aquastreamult:
@@ -1182,7 +2245,7 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 				return 0444;
 			break;
 		default:
-			if (channel < priv->num_fans)
+			if (channel < priv->desc->num_fans)
 				return 0444;
 			break;
 		}
@@ -1191,7 +2254,7 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 		switch (priv->kind) {
 		case d5next:
 			/* Special case to support +5V and +12V voltage sensors */
-			if (channel < priv->num_fans + 2)
+			if (channel < priv->desc->num_fans + 2)
 				return 0444;
 			break;
 		case aquastreamult:
@@ -1201,7 +2264,7 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 				return 0444;
 			break;
 		default:
-			if (channel < priv->num_fans)
+			if (channel < priv->desc->num_fans)
 				return 0444;
 			break;
 		}
@@ -1213,59 +2276,250 @@ static umode_t aqc_is_visible(const void *data, enum hwmon_sensor_types type, u3
 	return 0;
 }
 
-/* Read device sensors by manually requesting the sensor report (legacy way) */
-static int aqc_legacy_read(struct aqc_data *priv)
+/* Feeds a new reading into the trend, elapsed is the time since the last one in ms */
+static void aqc_update_trend(struct aqc_trend *trend, s32 val, s64 elapsed)
 {
-	int ret, i, sensor_value;
+	s32 rate;
 
-	mutex_lock(&priv->mutex);
-
-	memset(priv->buffer, 0x00, priv->buffer_size);
-	ret = hid_hw_raw_request(priv->hdev, priv->status_report_id, priv->buffer,
-				 priv->buffer_size, HID_FEATURE_REPORT, HID_REQ_GET_REPORT);
-	if (ret < 0)
-		goto unlock_and_return;
+	if (val == -ENODATA) {
+		trend->valid = false;
+		trend->last = -ENODATA;
+		return;
+	}
 
-	/* Temperature sensor readings */
-	for (i = 0; i < priv->num_temp_sensors; i++) {
-		sensor_value = get_unaligned_le16(priv->buffer + priv->temp_sensor_start_offset +
-						  i * AQC_SENSOR_SIZE);
-		if (sensor_value == AQC_SENSOR_NA)
-			priv->temp_input[i] = -ENODATA;
+	/* Readings too far apart don't make a meaningful trend, start over */
+	if (elapsed <= 0 || elapsed > AQC_TREND_MAX_GAP) {
+		trend->valid = false;
+	} else if (trend->last != -ENODATA) {
+		rate = div64_s64((s64)(val - trend->last) * MSEC_PER_SEC * 60, elapsed);
+		if (trend->valid)
+			trend->rate += (rate - trend->rate) / AQC_TREND_WEIGHT;
 		else
-			priv->temp_input[i] = sensor_value * 10;
+			trend->rate = rate;
+		trend->valid = true;
 	}
 
-	/* Serial number */
-	if (priv->serial_number_start_offset) {
-		priv->serial_number[0] = get_unaligned_le16(priv->buffer +
-							    priv->serial_number_start_offset);
-	}
+	trend->last = val;
+}
 
-	/* Firmware version */
-	if (priv->firmware_version_offset) {
-		priv->firmware_version =
-		    get_unaligned_le16(priv->buffer + priv->firmware_version_offset);
-	}
+/* Adds a reading to the history, skipping missing ones */
+static void aqc_update_history(struct aqc_history *history, s32 val)
+{
+	if (val == -ENODATA)
+		return;
 
-	/* Special-case sensor readings */
-	switch (priv->kind) {
-	case aquastreamxt:
-		/* Read pump speed in RPM */
-		sensor_value = get_unaligned_le16(priv->buffer + priv->fan_sensor_offsets[0]);
-		priv->speed_input[0] = aqc_aquastreamxt_convert_pump_rpm(sensor_value);
+	if (!history->count || val < history->lowest)
+		history->lowest = val;
+	if (!history->count || val > history->highest)
+		history->highest = val;
 
-		/* Read fan speed in RPM, if available */
-		sensor_value = get_unaligned_le16(priv->buffer + AQUASTREAMXT_FAN_STATUS_OFFSET);
-		if (sensor_value == AQUASTREAMXT_FAN_STOPPED) {
-			priv->speed_input[1] = 0;
-		} else {
-			sensor_value =
-			    get_unaligned_le16(priv->buffer + priv->fan_sensor_offsets[1]);
-			priv->speed_input[1] = aqc_aquastreamxt_convert_fan_rpm(sensor_value);
-		}
+	history->sum += val;
+	history->count++;
+}
 
-		/* Calculation derived from linear regression */
+/* Restarts the history from the given reading */
+static void aqc_reset_history(struct aqc_history *history, s32 val)
+{
+	memset(history, 0, sizeof(*history));
+	aqc_update_history(history, val);
+}
+
+enum aqc_history_value {
+	AQC_HISTORY_LOWEST,
+	AQC_HISTORY_HIGHEST,
+	AQC_HISTORY_AVERAGE,
+};
+
+static int aqc_read_history(struct aqc_data *priv, struct aqc_history *history, int which,
+			    long *val)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	if (!history->count) {
+		ret = -ENODATA;
+	} else {
+		switch (which) {
+		case AQC_HISTORY_LOWEST:
+			*val = history->lowest;
+			break;
+		case AQC_HISTORY_HIGHEST:
+			*val = history->highest;
+			break;
+		default:
+			*val = div_s64(history->sum, history->count);
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+
+	return ret;
+}
+
+static void aqc_reset_channel_history(struct aqc_data *priv, struct aqc_history *history,
+				      s32 val)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	aqc_reset_history(history, val);
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+}
+
+/*
+ * Integrates a reading over the time between two reports, using the average of both
+ * readings. Intervals longer than max_gap or with a missing reading are left out.
+ */
+static void aqc_integrate(struct aqc_integral *integral, s32 val, s64 elapsed, s64 max_gap)
+{
+	if (val != -ENODATA && integral->last != -ENODATA && elapsed > 0 && elapsed <= max_gap)
+		integral->total += div_u64(((u64)integral->last + val) * elapsed, 2);
+
+	integral->last = val;
+}
+
+/* Flow channels, in dL/h */
+static bool aqc_is_flow_channel(struct aqc_data *priv, int channel)
+{
+	switch (priv->kind) {
+	case aquaero:
+	case quadro:
+	case octo:
+		return channel >= priv->desc->num_fans &&
+		       channel < priv->desc->num_fans + priv->desc->num_flow_sensors +
+				 priv->desc->num_aquabus_flow_sensors;
+	case highflownext:
+	case highflow:
+		return channel == 0;
+	case poweradjust3:
+		return channel == 1;
+	case aquastreamult:
+		return channel == 3;
+	default:
+		return false;
+	}
+}
+
+/* Accounts the interval since the previous pushed report, history_lock must be held */
+static void aqc_update_report_stats(struct aqc_data *priv, s64 elapsed)
+{
+	s64 jitter = abs(elapsed - AQC_REPORT_PERIOD);
+	int i;
+
+	priv->reports_received++;
+
+	/* First report */
+	if (elapsed <= 0)
+		return;
+
+	if (elapsed > AQC_REPORT_GAP_FACTOR * AQC_REPORT_PERIOD)
+		priv->report_gaps++;
+
+	for (i = 0; i < ARRAY_SIZE(aqc_report_jitter_bounds); i++) {
+		if (jitter < aqc_report_jitter_bounds[i])
+			break;
+	}
+	priv->report_jitter[i]++;
+}
+
+/* Derives values that depend on consecutive reports, called after each one is parsed */
+static void aqc_process_report(struct aqc_data *priv)
+{
+	ktime_t now = ktime_get();
+	s64 elapsed = priv->last_report ? ktime_ms_delta(now, priv->last_report) : 0;
+	s64 max_gap = jiffies_to_msecs(STATUS_UPDATE_INTERVAL);
+	unsigned long flags;
+	int i;
+
+	/* Legacy devices are only read on demand, so allow for longer intervals */
+	if (priv->status_report_id != 0)
+		max_gap = AQC_TREND_MAX_GAP;
+
+	/* The device was idle, start over as if this was the first report */
+	if (READ_ONCE(priv->report_stream_resumed)) {
+		WRITE_ONCE(priv->report_stream_resumed, false);
+		elapsed = 0;
+	}
+
+	for (i = 0; i < priv->num_temp_channels; i++)
+		aqc_update_trend(&priv->temp_trend[i], priv->temp_input[i], elapsed);
+
+	for (i = 0; i < priv->num_speed_channels; i++)
+		aqc_update_trend(&priv->speed_trend[i], priv->speed_input[i], elapsed);
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	for (i = 0; i < priv->num_temp_channels; i++)
+		aqc_update_history(&priv->temp_history[i], priv->temp_input[i]);
+	for (i = 0; i < priv->num_speed_channels; i++) {
+		aqc_update_history(&priv->speed_history[i], priv->speed_input[i]);
+		if (aqc_is_flow_channel(priv, i))
+			aqc_integrate(&priv->volume[i], priv->speed_input[i], elapsed, max_gap);
+	}
+	for (i = 0; i < priv->num_power_channels; i++) {
+		aqc_update_history(&priv->power_history[i], priv->power_input[i]);
+		aqc_integrate(&priv->energy[i], priv->power_input[i], elapsed, max_gap);
+	}
+	if (priv->status_report_id == 0)
+		aqc_update_report_stats(priv, elapsed);
+	priv->last_report = now;
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+}
+
+/* Read device sensors by manually requesting the sensor report (legacy way) */
+static int aqc_legacy_read(struct aqc_data *priv)
+{
+	int ret, i, sensor_value;
+
+	mutex_lock(&priv->mutex);
+
+	memset(priv->buffer, 0x00, priv->buffer_size);
+	ret = hid_hw_raw_request(priv->hdev, priv->status_report_id, priv->buffer,
+				 priv->buffer_size, HID_FEATURE_REPORT, HID_REQ_GET_REPORT);
+	if (ret < 0)
+		goto unlock_and_return;
+
+	/* Temperature sensor readings */
+	for (i = 0; i < priv->desc->num_temp_sensors; i++) {
+		sensor_value = get_unaligned_le16(priv->buffer +
+						  priv->desc->temp_sensor_start_offset +
+						  i * AQC_SENSOR_SIZE);
+		if (sensor_value == AQC_SENSOR_NA)
+			priv->temp_input[i] = -ENODATA;
+		else
+			priv->temp_input[i] = sensor_value * 10;
+	}
+
+	/* Serial number */
+	if (priv->desc->serial_number_start_offset) {
+		priv->serial_number[0] = get_unaligned_le16(priv->buffer +
+							    priv->desc->serial_number_start_offset);
+	}
+
+	/* Firmware version */
+	if (priv->desc->firmware_version_offset) {
+		priv->firmware_version =
+		    get_unaligned_le16(priv->buffer + priv->desc->firmware_version_offset);
+	}
+
+	/* Special-case sensor readings */
+	switch (priv->kind) {
+	case aquastreamxt:
+		/* Read pump speed in RPM */
+		sensor_value = get_unaligned_le16(priv->buffer + priv->desc->fan_sensor_offsets[0]);
+		priv->speed_input[0] = aqc_aquastreamxt_convert_pump_rpm(sensor_value);
+
+		/* Read fan speed in RPM, if available */
+		sensor_value = get_unaligned_le16(priv->buffer + AQUASTREAMXT_FAN_STATUS_OFFSET);
+		if (sensor_value == AQUASTREAMXT_FAN_STOPPED) {
+			priv->speed_input[1] = 0;
+		} else {
+			sensor_value =
+			    get_unaligned_le16(priv->buffer + priv->desc->fan_sensor_offsets[1]);
+			priv->speed_input[1] = aqc_aquastreamxt_convert_fan_rpm(sensor_value);
+		}
+
+		/* Calculation derived from linear regression */
 		sensor_value = get_unaligned_le16(priv->buffer + AQUASTREAMXT_PUMP_CURR_OFFSET);
 		priv->current_input[0] = DIV_ROUND_CLOSEST(sensor_value * 176, 100) - 52;
 
@@ -1278,7 +2532,7 @@ static int aqc_legacy_read(struct aqc_data *priv)
 	case highflow:
 		/* Read flow speed */
 		priv->speed_input[0] = get_unaligned_le16(priv->buffer +
-							  priv->flow_sensors_start_offset);
+							  priv->desc->flow_sensors_start_offset);
 		break;
 	case poweradjust3:
 		/* Read fan RPM, voltage and current */
@@ -1290,13 +2544,15 @@ static int aqc_legacy_read(struct aqc_data *priv)
 							    POWERADJUST3_FAN_CURR_OFFSET);
 
 		/* Read flow speed */
-		sensor_value = get_unaligned_le16(priv->buffer + priv->flow_sensors_start_offset);
+		sensor_value = get_unaligned_le16(priv->buffer +
+						  priv->desc->flow_sensors_start_offset);
 		priv->speed_input[1] = DIV_ROUND_CLOSEST(sensor_value, 10);
 		break;
 	default:
 		break;
 	}
 
+	aqc_process_report(priv);
 	priv->updated = jiffies;
 
 unlock_and_return:
@@ -1304,11 +2560,112 @@ unlock_and_return:
 	return ret;
 }
 
-static int aqc_read(struct device *dev, enum hwmon_sensor_types type, u32 attr,
-		    int channel, long *val)
+static bool aqc_genl_listening(void);
+
+/* Reopens the input stream if it was closed, expects idle_mutex to be locked */
+static int aqc_idle_wake(struct aqc_data *priv)
 {
 	int ret;
-	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (!priv->idle)
+		return 0;
+
+	reinit_completion(&priv->report_received);
+	/* Set before reports can arrive again, the report path clears it */
+	WRITE_ONCE(priv->report_stream_resumed, true);
+	ret = hid_hw_open(priv->hdev);
+	if (ret < 0)
+		return ret;
+
+	priv->idle = false;
+	if (priv->idle_timeout)
+		mod_delayed_work(system_wq, &priv->idle_work, priv->idle_timeout * HZ);
+
+	return 0;
+}
+
+/*
+ * Records a read for idle mode. If the input stream was closed, reopens it and waits
+ * for the first report, for up to the update interval
+ */
+static void aqc_idle_access(struct aqc_data *priv)
+{
+	mutex_lock(&priv->idle_mutex);
+	priv->last_access = jiffies;
+	aqc_idle_wake(priv);
+	mutex_unlock(&priv->idle_mutex);
+
+	/* Concurrent readers wait for the same report */
+	if (!completion_done(&priv->report_received))
+		wait_for_completion_interruptible_timeout(&priv->report_received,
+							  STATUS_UPDATE_INTERVAL);
+}
+
+/* Keeps the input stream open for a consumer of pushed samples, such as an IIO buffer */
+static void aqc_idle_hold(struct aqc_data *priv)
+{
+	mutex_lock(&priv->idle_mutex);
+	priv->idle_holders++;
+	aqc_idle_wake(priv);
+	mutex_unlock(&priv->idle_mutex);
+}
+
+static void aqc_idle_release(struct aqc_data *priv)
+{
+	mutex_lock(&priv->idle_mutex);
+	priv->idle_holders--;
+	/* The timeout counts from when the last consumer went away */
+	priv->last_access = jiffies;
+	mutex_unlock(&priv->idle_mutex);
+}
+
+/*
+ * Closes the input stream once idle_timeout passed without reads or consumers. Netlink
+ * subscribers are only known by polling, so while the stream is closed, this keeps
+ * checking for them once per report period
+ */
+static void aqc_idle_work(struct work_struct *work)
+{
+	struct aqc_data *priv = container_of(to_delayed_work(work), struct aqc_data, idle_work);
+	unsigned long expires;
+
+	mutex_lock(&priv->idle_mutex);
+	if (!priv->idle_timeout)
+		goto unlock_and_return;
+
+	if (priv->idle) {
+		if (aqc_genl_listening())
+			aqc_idle_wake(priv);
+		else
+			schedule_delayed_work(&priv->idle_work,
+					      msecs_to_jiffies(AQC_REPORT_PERIOD));
+		goto unlock_and_return;
+	}
+
+	if (priv->idle_holders || aqc_genl_listening())
+		priv->last_access = jiffies;
+
+	expires = priv->last_access + priv->idle_timeout * HZ;
+	if (time_before(jiffies, expires)) {
+		schedule_delayed_work(&priv->idle_work, expires - jiffies);
+		goto unlock_and_return;
+	}
+
+	hid_hw_close(priv->hdev);
+	priv->idle = true;
+	schedule_delayed_work(&priv->idle_work, msecs_to_jiffies(AQC_REPORT_PERIOD));
+
+unlock_and_return:
+	mutex_unlock(&priv->idle_mutex);
+}
+
+/* Makes sure the sensor values are current, reading them from legacy devices if needed */
+static int aqc_update(struct aqc_data *priv)
+{
+	int ret;
+
+	if (priv->status_report_id == 0 && READ_ONCE(priv->idle_timeout))
+		aqc_idle_access(priv);
 
 	if (time_after(jiffies, priv->updated + STATUS_UPDATE_INTERVAL)) {
 		if (priv->status_report_id != 0) {
@@ -1321,6 +2678,21 @@ static int aqc_read(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 		}
 	}
 
+	return 0;
+}
+
+static int aqc_read(struct device *dev, enum hwmon_sensor_types type, u32 attr,
+		    int channel, long *val)
+{
+	int ret;
+	u64 energy;
+	unsigned long flags;
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	ret = aqc_update(priv);
+	if (ret < 0)
+		return ret;
+
 	switch (type) {
 	case hwmon_temp:
 		switch (attr) {
@@ -1330,6 +2702,12 @@ static int aqc_read(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 
 			*val = priv->temp_input[channel];
 			break;
+		case hwmon_temp_lowest:
+			return aqc_read_history(priv, &priv->temp_history[channel],
+						AQC_HISTORY_LOWEST, val);
+		case hwmon_temp_highest:
+			return aqc_read_history(priv, &priv->temp_history[channel],
+						AQC_HISTORY_HIGHEST, val);
 		case hwmon_temp_offset:
 			ret =
 			    aqc_get_ctrl_val(priv,
@@ -1338,6 +2716,15 @@ static int aqc_read(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 			if (ret < 0)
 				return ret;
 			*val *= 10;
+			break;
+		case hwmon_temp_max:
+			ret = aqc_get_ctrl_val(priv, channel == 1 ?
+					       AQUASTREAMXT_ALARM_EXT_TEMP_OFFSET :
+					       AQUASTREAMXT_ALARM_WATER_TEMP_OFFSET, val, AQC_LE16);
+			if (ret < 0)
+				return ret;
+			*val *= 10;
+			break;
 		default:
 			break;
 		}
@@ -1391,11 +2778,45 @@ static int aqc_read(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 		}
 		break;
 	case hwmon_power:
-		*val = priv->power_input[channel];
+		switch (attr) {
+		case hwmon_power_input_lowest:
+			return aqc_read_history(priv, &priv->power_history[channel],
+						AQC_HISTORY_LOWEST, val);
+		case hwmon_power_input_highest:
+			return aqc_read_history(priv, &priv->power_history[channel],
+						AQC_HISTORY_HIGHEST, val);
+		case hwmon_power_average:
+			return aqc_read_history(priv, &priv->power_history[channel],
+						AQC_HISTORY_AVERAGE, val);
+		default:
+			*val = priv->power_input[channel];
+			break;
+		}
+		break;
+	case AQC_HWMON_ENERGY:
+		spin_lock_irqsave(&priv->history_lock, flags);
+		energy = div_u64(priv->energy[channel].total, 1000);
+		spin_unlock_irqrestore(&priv->history_lock, flags);
+#if KERNEL_VERSION(6, 16, 0) <= LINUX_VERSION_CODE
+		/* The hwmon core passes a 64-bit value for energy64 attributes */
+		*(s64 *)val = energy;
+#else
+		*val = min_t(u64, energy, LONG_MAX);
+#endif
 		break;
 	case hwmon_pwm:
 		switch (attr) {
 		case hwmon_pwm_enable:
+			if (priv->kind == aquastreamxt) {
+				ret = aqc_get_ctrl_val(priv, AQUASTREAMXT_FAN_MODE_CTRL_OFFSET, val,
+						       AQC_8);
+				if (ret < 0)
+					return ret;
+
+				*val = (*val & AQUASTREAMXT_FAN_MODE_CTRL_AUTO) ? 2 : 1;
+				break;
+			}
+
 			ret = aqc_get_ctrl_val(priv, priv->fan_ctrl_offsets[channel], val, AQC_8);
 			if (ret < 0)
 				return ret;
@@ -1404,44 +2825,9 @@ static int aqc_read(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 			*val = *val + 1;
 			break;
 		case hwmon_pwm_input:
-			switch (priv->kind) {
-			case aquaero:
-				ret =
-				    aqc_get_ctrl_val(priv,
-						     AQUAERO_CTRL_PRESET_START +
-						     channel * AQUAERO_CTRL_PRESET_SIZE,
-						     val, AQC_BE16);
-				if (ret < 0)
-					return ret;
-				*val = aqc_percent_to_pwm(*val);
-				break;
-			case aquastreamxt:
-				if (channel == 0) {
-					ret =
-					    aqc_get_ctrl_val(priv, priv->fan_ctrl_offsets[channel],
-							     val, AQC_LE16);
-					if (ret < 0)
-						return ret;
-					*val = aqc_aquastreamxt_convert_pump_rpm(*val);
-					*val = aqc_aquastreamxt_rpm_to_pwm(*val);
-				} else {
-					ret =
-					    aqc_get_ctrl_val(priv, priv->fan_ctrl_offsets[channel],
-							     val, AQC_8);
-					if (ret < 0)
-						return ret;
-				}
-				break;
-			default:
-				ret =
-				    aqc_get_ctrl_val(priv,
-						     priv->fan_ctrl_offsets[channel] +
-						     AQC_FAN_CTRL_PWM_OFFSET, val, AQC_BE16);
-				if (ret < 0)
-					return ret;
-				*val = aqc_percent_to_pwm(*val);
-				break;
-			}
+			ret = aqc_get_pwm_vals(priv, channel, val, 1);
+			if (ret < 0)
+				return ret;
 			break;
 		case hwmon_pwm_auto_channels_temp:
 			ret =
@@ -1493,14 +2879,15 @@ static int aqc_read_string(struct device *dev, enum hwmon_sensor_types type, u32
 	struct aqc_data *priv = dev_get_drvdata(dev);
 
 	/* Number of sensors that are not calculated */
-	int num_non_calc_sensors = priv->num_temp_sensors + priv->num_virtual_temp_sensors;
+	int num_non_calc_sensors = priv->desc->num_temp_sensors +
+				   priv->desc->num_virtual_temp_sensors;
 
 	/* Number of sensors that are native */
-	int num_native_sensors = priv->num_calc_virt_temp_sensors + num_non_calc_sensors;
+	int num_native_sensors = priv->desc->num_calc_virt_temp_sensors + num_non_calc_sensors;
 
 	switch (type) {
 	case hwmon_temp:
-		if (channel < priv->num_temp_sensors) {
+		if (channel < priv->desc->num_temp_sensors) {
 			*str = priv->temp_label[channel];
 		} else {
 			if (priv->kind == aquaero && channel >= num_native_sensors)
@@ -1510,7 +2897,8 @@ static int aqc_read_string(struct device *dev, enum hwmon_sensor_types type, u32
 				*str =
 				    priv->calc_virtual_temp_label[channel - num_non_calc_sensors];
 			else
-				*str = priv->virtual_temp_label[channel - priv->num_temp_sensors];
+				*str = priv->virtual_temp_label[channel -
+								priv->desc->num_temp_sensors];
 		}
 
 		break;
@@ -1518,6 +2906,7 @@ static int aqc_read_string(struct device *dev, enum hwmon_sensor_types type, u32
 		*str = priv->speed_label[channel];
 		break;
 	case hwmon_power:
+	case AQC_HWMON_ENERGY:
 		*str = priv->power_label[channel];
 		break;
 	case hwmon_in:
@@ -1596,20 +2985,115 @@ static int aqc_leakshield_send_report(struct aqc_data *priv, int channel, long v
 	return ret;
 }
 
+static bool aqc_has_virt_sensors_transfer(struct aqc_data *priv)
+{
+	return priv->kind == quadro || priv->kind == octo;
+}
+
+static void aqc_init_virt_sensors_buffer(u8 *buffer)
+{
+	int i;
+
+	buffer[0] = AQC_VIRT_SENSORS_REPORT_ID;
+	for (i = 0; i < AQC_VIRT_SENSORS_NUM; i++)
+		put_unaligned_be16(AQC_SENSOR_NA, buffer + AQC_VIRT_SENSORS_VALUES_OFFSET +
+				   i * AQC_SENSOR_SIZE);
+	memset(buffer + AQC_VIRT_SENSORS_TRAILER_OFFSET, AQC_VIRT_SENSORS_TRAILER_VALUE,
+	       AQC_VIRT_SENSORS_NUM);
+}
+
+/* Sends the virtual sensor values in one checksummed bulk transfer, mutex must be held */
+static int aqc_send_virt_sensors(struct aqc_data *priv)
+{
+	struct usb_interface *intf = to_usb_interface(priv->hdev->dev.parent);
+	struct usb_device *usb_dev = interface_to_usbdev(intf);
+	u8 *buffer = priv->virt_sensors_buffer;
+	int actual_length, ret;
+	u16 checksum;
+
+	/* Init and xorout value for CRC-16/USB is 0xffff */
+	checksum = crc16(0xffff, buffer + AQC_VIRT_SENSORS_CHECKSUM_START,
+			 AQC_VIRT_SENSORS_CHECKSUM_OFFSET - AQC_VIRT_SENSORS_CHECKSUM_START);
+	checksum ^= 0xffff;
+	put_unaligned_be16(checksum, buffer + AQC_VIRT_SENSORS_CHECKSUM_OFFSET);
+
+	ret = usb_bulk_msg(usb_dev, usb_sndbulkpipe(usb_dev, AQC_VIRT_SENSORS_ENDPOINT), buffer,
+			   AQC_VIRT_SENSORS_SIZE, &actual_length, 1000);
+	if (ret < 0)
+		return ret;
+
+	if (actual_length != AQC_VIRT_SENSORS_SIZE)
+		return -EIO;
+
+	return 0;
+}
+
+static void aqc_virt_sensors_work(struct work_struct *work)
+{
+	struct aqc_data *priv = container_of(to_delayed_work(work), struct aqc_data,
+					     virt_sensors_work);
+	int ret;
+
+	mutex_lock(&priv->mutex);
+	ret = aqc_send_virt_sensors(priv);
+	priv->virt_sensors_sent = jiffies;
+	mutex_unlock(&priv->mutex);
+
+	if (ret < 0)
+		hid_warn(priv->hdev, "failed to send virtual sensors (%d)\n", ret);
+}
+
+/*
+ * Schedules sending the virtual sensors, at most once per AQC_VIRT_SENSORS_MIN_INTERVAL.
+ * Updates made in the meantime are coalesced into the pending transfer.
+ */
+static void aqc_schedule_virt_sensors(struct aqc_data *priv)
+{
+	unsigned long next = priv->virt_sensors_sent +
+			     msecs_to_jiffies(AQC_VIRT_SENSORS_MIN_INTERVAL);
+	unsigned long delay = 0;
+
+	if (time_before(jiffies, next))
+		delay = next - jiffies;
+
+	schedule_delayed_work(&priv->virt_sensors_work, delay);
+}
+
 static int aqc_write(struct device *dev, enum hwmon_sensor_types type, u32 attr, int channel,
 		     long val)
 {
-	int ret, pwm_value, temp_sensor;
+	int ret, len, temp_sensor;
 	long ctrl_mode;
 	/* Arrays for setting multiple values at once in the control report */
-	int ctrl_values_offsets[4];
-	long ctrl_values[4];
-	int ctrl_values_types[4];
+	int ctrl_values_offsets[AQC_PWM_MAX_CTRL_VALS];
+	long ctrl_values[AQC_PWM_MAX_CTRL_VALS];
+	int ctrl_values_types[AQC_PWM_MAX_CTRL_VALS];
 	struct aqc_data *priv = dev_get_drvdata(dev);
+	int i;
 
 	switch (type) {
+	case hwmon_chip:
+		switch (attr) {
+		case hwmon_chip_temp_reset_history:
+			for (i = 0; i < priv->num_temp_channels; i++)
+				aqc_reset_channel_history(priv, &priv->temp_history[i],
+							  priv->temp_input[i]);
+			break;
+		case hwmon_chip_power_reset_history:
+			for (i = 0; i < priv->num_power_channels; i++)
+				aqc_reset_channel_history(priv, &priv->power_history[i],
+							  priv->power_input[i]);
+			break;
+		default:
+			return -EOPNOTSUPP;
+		}
+		break;
 	case hwmon_temp:
 		switch (attr) {
+		case hwmon_temp_reset_history:
+			aqc_reset_channel_history(priv, &priv->temp_history[channel],
+						  priv->temp_input[channel]);
+			break;
 		case hwmon_temp_offset:
 			/* Limit temp offset to +/- 15K as in the official software */
 			val = clamp_val(val, -15000, 15000) / 10;
@@ -1620,6 +3104,14 @@ static int aqc_write(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 			if (ret < 0)
 				return ret;
 			break;
+		case hwmon_temp_max:
+			val = clamp_val(val, 0, 100000) / 10;
+			ret = aqc_set_ctrl_val(priv, channel == 1 ?
+					       AQUASTREAMXT_ALARM_EXT_TEMP_OFFSET :
+					       AQUASTREAMXT_ALARM_WATER_TEMP_OFFSET, val, AQC_LE16);
+			if (ret < 0)
+				return ret;
+			break;
 		default:
 			return -EOPNOTSUPP;
 		}
@@ -1654,17 +3146,47 @@ static int aqc_write(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 			return -EOPNOTSUPP;
 		}
 		break;
-	case hwmon_pwm:
+	case hwmon_power:
 		switch (attr) {
-		case hwmon_pwm_enable:
-			switch (priv->kind) {
+		case hwmon_power_reset_history:
+			aqc_reset_channel_history(priv, &priv->power_history[channel],
+						  priv->power_input[channel]);
+			break;
+		default:
+			return -EOPNOTSUPP;
+		}
+		break;
+	case hwmon_pwm:
+		switch (attr) {
+		case hwmon_pwm_enable:
+			switch (priv->kind) {
+			case aquastreamxt:
+				/* Manual or automatic mode, keeping the hold min power flag */
+				if (val < 1 || val > 2)
+					return -EINVAL;
+
+				ret = aqc_get_ctrl_val(priv, AQUASTREAMXT_FAN_MODE_CTRL_OFFSET,
+						       &ctrl_mode, AQC_8);
+				if (ret < 0)
+					return ret;
+
+				ctrl_mode &= AQUASTREAMXT_FAN_MODE_CTRL_HOLD_MIN;
+				ctrl_mode |= val == 1 ? AQUASTREAMXT_FAN_MODE_CTRL_MANUAL :
+					     AQUASTREAMXT_FAN_MODE_CTRL_AUTO;
+
+				aqc_stop_pwm_ramp(priv, channel);
+				ret = aqc_set_ctrl_val(priv, AQUASTREAMXT_FAN_MODE_CTRL_OFFSET,
+						       ctrl_mode, AQC_8);
+				if (ret < 0)
+					return ret;
+				return 0;
 			case d5next:
 				if (val < 0 || val > 3)
 					return -EINVAL;
 				break;
 			case octo:
 			case quadro:
-				if (val < 0 || val > priv->num_fans + 3)
+				if (val < 0 || val > priv->desc->num_fans + 3)
 					return -EINVAL;
 
 				/* Fan can't follow itself */
@@ -1691,6 +3213,9 @@ static int aqc_write(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 				return -EOPNOTSUPP;
 			}
 
+			/* The new mode takes over from an ongoing ramp */
+			aqc_stop_pwm_ramp(priv, channel);
+
 			if (val == 0) {
 				/* Set the fan to 100% as we don't control it anymore */
 				ret =
@@ -1713,78 +3238,17 @@ static int aqc_write(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 			if (val < 0 || val > 255)
 				return -EINVAL;
 
-			switch (priv->kind) {
-			case aquaero:
-				pwm_value = aqc_pwm_to_percent(val);
-				/* Write pwm value to preset corresponding to the channel */
-				ctrl_values_offsets[0] = AQUAERO_CTRL_PRESET_START +
-				    channel * AQUAERO_CTRL_PRESET_SIZE;
-				ctrl_values[0] = pwm_value;
-				ctrl_values_types[0] = AQC_BE16;
-
-				/* Write preset number in fan control source */
-				ctrl_values_offsets[1] = priv->fan_ctrl_offsets[channel] +
-				    AQUAERO_FAN_CTRL_SRC_OFFSET;
-				ctrl_values[1] = AQUAERO_CTRL_PRESET_ID + channel;
-				ctrl_values_types[1] = AQC_BE16;
-
-				/* Set minimum power to 0 to allow the fan to turn off */
-				ctrl_values_offsets[2] = priv->fan_ctrl_offsets[channel] +
-				    AQUAERO_FAN_CTRL_MIN_PWR_OFFSET;
-				ctrl_values[2] = 0;
-				ctrl_values_types[2] = AQC_BE16;
-
-				/*
-				 * Set maximum power to 100% to allow the fan to
-				 * reach maximum speed
-				 */
-				ctrl_values_offsets[3] = priv->fan_ctrl_offsets[channel] +
-				    AQUAERO_FAN_CTRL_MAX_PWR_OFFSET;
-				ctrl_values[3] = aqc_pwm_to_percent(255);
-				ctrl_values_types[3] = AQC_BE16;
-
-				ret = aqc_set_ctrl_vals(priv, ctrl_values_offsets, ctrl_values,
-							ctrl_values_types, 4);
-				if (ret < 0)
-					return ret;
-				break;
-			case aquastreamxt:
-				if (channel == 0) {
-					pwm_value = aqc_aquastreamxt_pwm_to_rpm(val);
-					pwm_value = aqc_aquastreamxt_convert_pump_rpm(pwm_value);
-					ctrl_values_offsets[0] = priv->fan_ctrl_offsets[channel];
-					ctrl_values[0] = pwm_value;
-					ctrl_values_types[0] = AQC_LE16;
-
-					/* Enable manual speed control */
-					ctrl_values_offsets[1] = AQUASTREAMXT_PUMP_MODE_CTRL_OFFSET;
-					ctrl_values[1] = AQUASTREAMXT_PUMP_MODE_CTRL_MANUAL;
-					ctrl_values_types[1] = AQC_8;
-				} else {
-					ctrl_values_offsets[0] = priv->fan_ctrl_offsets[channel];
-					ctrl_values[0] = val;
-					ctrl_values_types[0] = AQC_8;
-
-					/* Enable manual speed control */
-					ctrl_values_offsets[1] = AQUASTREAMXT_FAN_MODE_CTRL_OFFSET;
-					ctrl_values[1] = AQUASTREAMXT_FAN_MODE_CTRL_MANUAL;
-					ctrl_values_types[1] = AQC_8;
-				}
-				ret = aqc_set_ctrl_vals(priv, ctrl_values_offsets, ctrl_values,
-							ctrl_values_types, 2);
-				if (ret < 0)
-					return ret;
-				break;
-			default:
-				pwm_value = aqc_pwm_to_percent(val);
-				ret =
-				    aqc_set_ctrl_val(priv,
-						     priv->fan_ctrl_offsets[channel] +
-						     AQC_FAN_CTRL_PWM_OFFSET, pwm_value, AQC_BE16);
-				if (ret < 0)
-					return ret;
+			if (priv->pwm_ramps[channel].rate) {
+				aqc_start_pwm_ramp(priv, channel, val);
 				break;
 			}
+
+			len = aqc_pwm_to_ctrl_vals(priv, channel, val, ctrl_values_offsets,
+						   ctrl_values, ctrl_values_types);
+			ret = aqc_set_pwm_ctrl_vals(priv, ctrl_values_offsets, ctrl_values,
+						    ctrl_values_types, len);
+			if (ret < 0)
+				return ret;
 			break;
 		case hwmon_pwm_auto_channels_temp:
 			switch (val) {
@@ -1804,7 +3268,7 @@ static int aqc_write(struct device *dev, enum hwmon_sensor_types type, u32 attr,
 				return -EINVAL;
 			}
 
-			if (temp_sensor >= priv->num_temp_sensors)
+			if (temp_sensor >= priv->desc->num_temp_sensors)
 				return -EINVAL;
 
 			ret =
@@ -1984,7 +3448,7 @@ static ssize_t show_auto_temp(struct device *dev, struct device_attribute *attr,
 				   priv->fan_ctrl_offsets[nr] + AQC_FAN_CTRL_TEMP_CURVE_START +
 				   point * AQC_SENSOR_SIZE, &val, AQC_BE16);
 	if (ret < 0)
-		return -ENODATA;
+		return ret;
 
 	return sprintf(buf, "%d\n", (s16)val);
 }
@@ -2023,7 +3487,7 @@ static ssize_t show_auto_pwm(struct device *dev, struct device_attribute *attr,
 				   priv->fan_ctrl_offsets[nr] + AQC_FAN_CTRL_PWM_CURVE_START +
 				   point * AQC_SENSOR_SIZE, &val, AQC_BE16);
 	if (ret < 0)
-		return -ENODATA;
+		return ret;
 
 	return sprintf(buf, "%d\n", aqc_percent_to_pwm(val));
 }
@@ -2194,7 +3658,7 @@ static ssize_t show_curve_power_min(struct device *dev, struct device_attribute
 	int ret = aqc_get_ctrl_val(priv,
 				   priv->fan_curve_min_power_offsets[index], &val, AQC_BE16);
 	if (ret < 0)
-		return -ENODATA;
+		return ret;
 
 	return sprintf(buf, "%d\n", aqc_percent_to_pwm(val));
 }
@@ -2234,7 +3698,7 @@ static ssize_t show_curve_power_max(struct device *dev, struct device_attribute
 	int ret = aqc_get_ctrl_val(priv,
 				   priv->fan_curve_max_power_offsets[index], &val, AQC_BE16);
 	if (ret < 0)
-		return -ENODATA;
+		return ret;
 
 	return sprintf(buf, "%d\n", aqc_percent_to_pwm(val));
 }
@@ -2274,7 +3738,7 @@ static ssize_t show_curve_power_fallback(struct device *dev, struct device_attri
 	int ret = aqc_get_ctrl_val(priv,
 				   priv->fan_curve_fallback_power_offsets[index], &val, AQC_BE16);
 	if (ret < 0)
-		return -ENODATA;
+		return ret;
 
 	return sprintf(buf, "%d\n", aqc_percent_to_pwm(val));
 }
@@ -2314,7 +3778,7 @@ static ssize_t show_curve_start_boost(struct device *dev, struct device_attribut
 	ret = aqc_get_ctrl_val(priv,
 			       priv->fan_curve_hold_start_offsets[index], &val, AQC_8);
 	if (ret < 0)
-		return -ENODATA;
+		return ret;
 
 	return sprintf(buf, "%d\n", aqc_get_bit_at_pos(val, FAN_CURVE_START_BOOST_BIT_POS));
 }
@@ -2358,204 +3822,2727 @@ static ssize_t show_curve_power_hold_min(struct device *dev, struct device_attri
 	ret = aqc_get_ctrl_val(priv,
 			       priv->fan_curve_hold_start_offsets[index], &val, AQC_8);
 	if (ret < 0)
-		return -ENODATA;
+		return ret;
+
+	return sprintf(buf, "%d\n", aqc_get_bit_at_pos(val, FAN_CURVE_HOLD_MIN_POWER_BIT_POS));
+}
+
+static ssize_t
+store_curve_power_hold_min(struct device *dev, struct device_attribute *attr, const char *buf,
+			   size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	int index = sattr->index;
+	unsigned long val, new_val;
+	int ret = kstrtoul(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val > 2)
+		return -EINVAL;
+
+	ret = aqc_get_ctrl_val(priv, priv->fan_curve_hold_start_offsets[index], &new_val, AQC_8);
+	if (ret < 0)
+		return ret;
+
+	new_val = aqc_set_bit_at_pos(new_val, FAN_CURVE_HOLD_MIN_POWER_BIT_POS, val);
+
+	ret = aqc_set_ctrl_val(priv, priv->fan_curve_hold_start_offsets[index], new_val, AQC_8);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+SENSOR_TEMPLATE(curve_power_min, "curve%d_power_min",
+		0644, show_curve_power_min, store_curve_power_min, 0);
+SENSOR_TEMPLATE(curve_power_max, "curve%d_power_max",
+		0644, show_curve_power_max, store_curve_power_max, 0);
+SENSOR_TEMPLATE(curve_power_fallback, "curve%d_power_fallback",
+		0644, show_curve_power_fallback, store_curve_power_fallback, 0);
+SENSOR_TEMPLATE(curve_start_boost, "curve%d_start_boost",
+		0644, show_curve_start_boost, store_curve_start_boost, 0);
+SENSOR_TEMPLATE(curve_power_hold_min, "curve%d_power_hold_min",
+		0644, show_curve_power_hold_min, store_curve_power_hold_min, 0);
+
+static umode_t aqc_params_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	/*
+	 * Pump channel on the D5 Next does not support the last two features,
+	 * "start boost" and "hold min power". Every other fan curve supports
+	 * all parameters.
+	 */
+	struct device *dev = kobj_to_dev(kobj);
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	int nr = index % 5;
+
+	if (priv->kind == d5next && nr > 2)
+		return 0;
+
+	return attr->mode;
+}
+
+static struct sensor_device_template *aqc_attributes_params_template[] = {
+	&sensor_dev_template_curve_power_min,
+	&sensor_dev_template_curve_power_max,
+	&sensor_dev_template_curve_power_fallback,
+	&sensor_dev_template_curve_start_boost,
+	&sensor_dev_template_curve_power_hold_min,
+	NULL
+};
+
+static const struct sensor_template_group aqc_curve_params_template_group = {
+	.templates = aqc_attributes_params_template,
+	.is_visible = aqc_params_is_visible,
+	.base = 1,
+};
+
+/* PID (target temperature) controller parameters */
+enum aqc_pid_param {
+	AQC_PID_TARGET,
+	AQC_PID_P,
+	AQC_PID_I,
+	AQC_PID_D1,
+	AQC_PID_D2,
+	AQC_PID_HYST,
+	AQC_PID_NUM_PARAMS
+};
+
+static const int aqc_pid_param_offsets[AQC_PID_NUM_PARAMS] = {
+	[AQC_PID_TARGET] = AQC_FAN_CTRL_PID_TARGET_OFFSET,
+	[AQC_PID_P] = AQC_FAN_CTRL_PID_P_OFFSET,
+	[AQC_PID_I] = AQC_FAN_CTRL_PID_I_OFFSET,
+	[AQC_PID_D1] = AQC_FAN_CTRL_PID_D1_OFFSET,
+	[AQC_PID_D2] = AQC_FAN_CTRL_PID_D2_OFFSET,
+	[AQC_PID_HYST] = AQC_FAN_CTRL_PID_HYST_OFFSET,
+};
+
+/* Target and hysteresis are temperatures in centidegrees, the gains are unitless */
+static bool aqc_pid_param_is_temp(int param)
+{
+	return param == AQC_PID_TARGET || param == AQC_PID_HYST;
+}
+
+/* Converts a raw PID parameter from the control report to its sysfs value */
+static long aqc_pid_param_from_raw(int param, long raw)
+{
+	if (aqc_pid_param_is_temp(param))
+		return raw * 10;
+
+	return raw & 0xFFFF;
+}
+
+/* Converts a PID parameter from sysfs to its raw value in the control report */
+static int aqc_pid_param_to_raw(int param, long val, long *raw)
+{
+	if (aqc_pid_param_is_temp(param)) {
+		val = DIV_ROUND_CLOSEST(val, 10);
+		if (val < S16_MIN || val > S16_MAX)
+			return -EINVAL;
+	} else if (val < 0 || val > U16_MAX) {
+		return -EINVAL;
+	}
+
+	*raw = val;
+
+	return 0;
+}
+
+static ssize_t show_pid_param(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+	int param = sattr->index;
+	long val;
+	int ret = aqc_get_ctrl_val(priv,
+				   priv->fan_ctrl_offsets[sattr->nr] + aqc_pid_param_offsets[param],
+				   &val, AQC_BE16);
+	if (ret < 0)
+		return ret;
+
+	return sprintf(buf, "%ld\n", aqc_pid_param_from_raw(param, val));
+}
+
+static ssize_t
+store_pid_param(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+	int param = sattr->index;
+	long val, raw;
+	int ret = kstrtol(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+
+	ret = aqc_pid_param_to_raw(param, val, &raw);
+	if (ret < 0)
+		return ret;
+
+	ret = aqc_set_ctrl_val(priv,
+			       priv->fan_ctrl_offsets[sattr->nr] + aqc_pid_param_offsets[param],
+			       raw, AQC_BE16);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+/* All PID parameters at once, read from a single control report */
+static ssize_t show_pid_params(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	int offset = priv->fan_ctrl_offsets[sattr->index];
+	long vals[AQC_PID_NUM_PARAMS];
+	int ret, i, len = 0;
+
+	mutex_lock(&priv->mutex);
+	ret = aqc_get_ctrl_data(priv);
+	if (ret >= 0) {
+		for (i = 0; i < AQC_PID_NUM_PARAMS; i++)
+			vals[i] = (s16)get_unaligned_be16(priv->buffer + offset +
+							  aqc_pid_param_offsets[i]);
+	}
+	mutex_unlock(&priv->mutex);
+
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < AQC_PID_NUM_PARAMS; i++)
+		len += sprintf(buf + len, "%s%ld", i ? " " : "",
+			       aqc_pid_param_from_raw(i, vals[i]));
+
+	return len + sprintf(buf + len, "\n");
+}
+
+/* Expects target, P, I, D1, D2 and hysteresis, which are written in one transaction */
+static ssize_t
+store_pid_params(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	int offset = priv->fan_ctrl_offsets[sattr->index];
+	int offsets[AQC_PID_NUM_PARAMS], types[AQC_PID_NUM_PARAMS];
+	long values[AQC_PID_NUM_PARAMS], val;
+	char input[96], *cur, *token;
+	int ret, len = 0;
+
+	if (strscpy(input, buf, sizeof(input)) < 0)
+		return -EINVAL;
+
+	cur = strim(input);
+	while ((token = strsep(&cur, " \t")) != NULL) {
+		if (*token == '\0')
+			continue;
+
+		if (len >= AQC_PID_NUM_PARAMS)
+			return -EINVAL;
+
+		ret = kstrtol(token, 10, &val);
+		if (ret < 0)
+			return ret;
+
+		ret = aqc_pid_param_to_raw(len, val, &values[len]);
+		if (ret < 0)
+			return ret;
+
+		offsets[len] = offset + aqc_pid_param_offsets[len];
+		types[len] = AQC_BE16;
+		len++;
+	}
+
+	if (len != AQC_PID_NUM_PARAMS)
+		return -EINVAL;
+
+	ret = aqc_set_ctrl_vals(priv, offsets, values, types, len);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+SENSOR_TEMPLATE_2(pid_target, "pid%d_target", 0644, show_pid_param, store_pid_param, 0,
+		  AQC_PID_TARGET);
+SENSOR_TEMPLATE_2(pid_p, "pid%d_p", 0644, show_pid_param, store_pid_param, 0, AQC_PID_P);
+SENSOR_TEMPLATE_2(pid_i, "pid%d_i", 0644, show_pid_param, store_pid_param, 0, AQC_PID_I);
+SENSOR_TEMPLATE_2(pid_d1, "pid%d_d1", 0644, show_pid_param, store_pid_param, 0, AQC_PID_D1);
+SENSOR_TEMPLATE_2(pid_d2, "pid%d_d2", 0644, show_pid_param, store_pid_param, 0, AQC_PID_D2);
+SENSOR_TEMPLATE_2(pid_hyst, "pid%d_hyst", 0644, show_pid_param, store_pid_param, 0,
+		  AQC_PID_HYST);
+SENSOR_TEMPLATE(pid_params, "pid%d_params", 0644, show_pid_params, store_pid_params, 0);
+
+static umode_t aqc_pid_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	/* Created only for devices with the fan control layout of the D5 Next, Octo and Quadro */
+	return attr->mode;
+}
+
+static struct sensor_device_template *aqc_attributes_pid_template[] = {
+	&sensor_dev_template_pid_target,
+	&sensor_dev_template_pid_p,
+	&sensor_dev_template_pid_i,
+	&sensor_dev_template_pid_d1,
+	&sensor_dev_template_pid_d2,
+	&sensor_dev_template_pid_hyst,
+	&sensor_dev_template_pid_params,
+	NULL
+};
+
+static const struct sensor_template_group aqc_pid_template_group = {
+	.templates = aqc_attributes_pid_template,
+	.is_visible = aqc_pid_is_visible,
+	.base = 1,
+};
+
+/* Aquaero firmware controllers, set up through aquasuite to drive fans */
+enum aquaero_ctrl_kind {
+	AQUAERO_CTRL_TWO_POINT,
+	AQUAERO_CTRL_SET_POINT,
+	AQUAERO_CTRL_CURVE,
+};
+
+/* Controller fields are consecutive BE16 values, converted according to their type */
+enum aquaero_ctrl_field {
+	AQUAERO_FIELD_TEMP_SRC,	/* Temperature sensor, 1-based, 0 if none */
+	AQUAERO_FIELD_TEMP,	/* Centidegrees */
+	AQUAERO_FIELD_RAW,	/* Gains and times, unitless */
+	AQUAERO_FIELD_PWM,	/* Centi-percent */
+};
+
+#define AQUAERO_CTRL_MAX_FIELDS		(2 + 2 * AQC_FAN_CTRL_CURVE_NUM_POINTS)
+
+struct aquaero_ctrl_desc {
+	const char *name;
+	int count;
+	int start;
+	int size;
+	int num_fields;
+	u8 fields[AQUAERO_CTRL_MAX_FIELDS];
+};
+
+static const struct aquaero_ctrl_desc aquaero_ctrl_descs[] = {
+	[AQUAERO_CTRL_TWO_POINT] = {
+		.name = "twopoint",
+		.count = AQUAERO_NUM_TWO_POINT_CTRLS,
+		.start = AQUAERO_TWO_POINT_CTRL_START,
+		.size = AQUAERO_TWO_POINT_CTRL_SIZE,
+		.num_fields = 3,
+		/* Sensor, switch on and switch off temperatures */
+		.fields = { AQUAERO_FIELD_TEMP_SRC, AQUAERO_FIELD_TEMP, AQUAERO_FIELD_TEMP },
+	},
+	[AQUAERO_CTRL_SET_POINT] = {
+		.name = "setpoint",
+		.count = AQUAERO_NUM_SET_POINT_CTRLS,
+		.start = AQUAERO_SET_POINT_CTRL_START,
+		.size = AQUAERO_SET_POINT_CTRL_SIZE,
+		.num_fields = 7,
+		/* Sensor, target temperature, P, I, D, reset time and hysteresis */
+		.fields = { AQUAERO_FIELD_TEMP_SRC, AQUAERO_FIELD_TEMP, AQUAERO_FIELD_RAW,
+			    AQUAERO_FIELD_RAW, AQUAERO_FIELD_RAW, AQUAERO_FIELD_RAW,
+			    AQUAERO_FIELD_TEMP },
+	},
+	[AQUAERO_CTRL_CURVE] = {
+		.name = "curvectrl",
+		.count = AQUAERO_NUM_CURVE_CTRLS,
+		.start = AQUAERO_CURVE_CTRL_START,
+		.size = AQUAERO_CURVE_CTRL_SIZE,
+		.num_fields = AQUAERO_CTRL_MAX_FIELDS,
+		/* Sensor, start temperature, 16 temperatures and 16 PWM values */
+		.fields = { AQUAERO_FIELD_TEMP_SRC, AQUAERO_FIELD_TEMP,
+			    [2 ... AQC_FAN_CTRL_CURVE_NUM_POINTS + 1] = AQUAERO_FIELD_TEMP,
+			    [AQC_FAN_CTRL_CURVE_NUM_POINTS + 2 ... AQUAERO_CTRL_MAX_FIELDS - 1] =
+				AQUAERO_FIELD_PWM },
+	},
+};
+
+static long aquaero_ctrl_field_from_raw(int field, u16 raw)
+{
+	switch (field) {
+	case AQUAERO_FIELD_TEMP_SRC:
+		return raw == AQUAERO_CTRL_NO_TEMP_SRC ? 0 : raw + 1;
+	case AQUAERO_FIELD_TEMP:
+		return (s16)raw * 10;
+	case AQUAERO_FIELD_PWM:
+		return aqc_percent_to_pwm(raw);
+	default:
+		return raw;
+	}
+}
+
+static int aquaero_ctrl_field_to_raw(struct aqc_data *priv, int field, long val, long *raw)
+{
+	switch (field) {
+	case AQUAERO_FIELD_TEMP_SRC:
+		if (val < 0 ||
+		    val > priv->desc->num_temp_sensors + priv->desc->num_virtual_temp_sensors +
+			  priv->desc->num_calc_virt_temp_sensors)
+			return -EINVAL;
+
+		*raw = val == 0 ? AQUAERO_CTRL_NO_TEMP_SRC : val - 1;
+		break;
+	case AQUAERO_FIELD_TEMP:
+		val = DIV_ROUND_CLOSEST(val, 10);
+		if (val < S16_MIN || val > S16_MAX)
+			return -EINVAL;
+
+		*raw = val;
+		break;
+	case AQUAERO_FIELD_PWM:
+		if (val < 0 || val > 255)
+			return -EINVAL;
+
+		*raw = aqc_pwm_to_percent(val);
+		break;
+	default:
+		if (val < 0 || val > U16_MAX)
+			return -EINVAL;
+
+		*raw = val;
+		break;
+	}
+
+	return 0;
+}
+
+/* Reads all fields of a controller from a single control report */
+static ssize_t show_aquaero_ctrl(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+	const struct aquaero_ctrl_desc *desc = &aquaero_ctrl_descs[sattr->index];
+	int offset = desc->start + sattr->nr * desc->size;
+	u16 vals[AQUAERO_CTRL_MAX_FIELDS];
+	int ret, i, len = 0;
+
+	mutex_lock(&priv->mutex);
+	ret = aqc_get_ctrl_data(priv);
+	if (ret >= 0) {
+		for (i = 0; i < desc->num_fields; i++)
+			vals[i] = get_unaligned_be16(priv->buffer + offset + i * AQC_SENSOR_SIZE);
+	}
+	mutex_unlock(&priv->mutex);
+
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < desc->num_fields; i++)
+		len += sprintf(buf + len, "%s%ld", i ? " " : "",
+			       aquaero_ctrl_field_from_raw(desc->fields[i], vals[i]));
+
+	return len + sprintf(buf + len, "\n");
+}
+
+/* Expects all fields of the controller, which are written in one transaction */
+static ssize_t
+store_aquaero_ctrl(struct device *dev, struct device_attribute *attr, const char *buf,
+		   size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+	const struct aquaero_ctrl_desc *desc = &aquaero_ctrl_descs[sattr->index];
+	int offset = desc->start + sattr->nr * desc->size;
+	int offsets[AQUAERO_CTRL_MAX_FIELDS], types[AQUAERO_CTRL_MAX_FIELDS];
+	long values[AQUAERO_CTRL_MAX_FIELDS], val;
+	char input[256], *cur, *token;
+	int ret, len = 0;
+
+	if (strscpy(input, buf, sizeof(input)) < 0)
+		return -EINVAL;
+
+	cur = strim(input);
+	while ((token = strsep(&cur, " \t")) != NULL) {
+		if (*token == '\0')
+			continue;
+
+		if (len >= desc->num_fields)
+			return -EINVAL;
+
+		ret = kstrtol(token, 10, &val);
+		if (ret < 0)
+			return ret;
+
+		ret = aquaero_ctrl_field_to_raw(priv, desc->fields[len], val, &values[len]);
+		if (ret < 0)
+			return ret;
+
+		offsets[len] = offset + len * AQC_SENSOR_SIZE;
+		types[len] = AQC_BE16;
+		len++;
+	}
+
+	if (len != desc->num_fields)
+		return -EINVAL;
+
+	ret = aqc_set_ctrl_vals(priv, offsets, values, types, len);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+SENSOR_TEMPLATE_2(aquaero_two_point, "twopoint%d_params", 0644, show_aquaero_ctrl,
+		  store_aquaero_ctrl, 0, AQUAERO_CTRL_TWO_POINT);
+SENSOR_TEMPLATE_2(aquaero_set_point, "setpoint%d_params", 0644, show_aquaero_ctrl,
+		  store_aquaero_ctrl, 0, AQUAERO_CTRL_SET_POINT);
+SENSOR_TEMPLATE_2(aquaero_curve, "curvectrl%d_params", 0644, show_aquaero_ctrl,
+		  store_aquaero_ctrl, 0, AQUAERO_CTRL_CURVE);
+
+static umode_t aquaero_ctrl_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	/* Created only for the Aquaero */
+	return attr->mode;
+}
+
+static struct sensor_device_template *aquaero_attributes_two_point_template[] = {
+	&sensor_dev_template_aquaero_two_point,
+	NULL
+};
+
+static struct sensor_device_template *aquaero_attributes_set_point_template[] = {
+	&sensor_dev_template_aquaero_set_point,
+	NULL
+};
+
+static struct sensor_device_template *aquaero_attributes_curve_template[] = {
+	&sensor_dev_template_aquaero_curve,
+	NULL
+};
+
+static const struct sensor_template_group aquaero_two_point_template_group = {
+	.templates = aquaero_attributes_two_point_template,
+	.is_visible = aquaero_ctrl_is_visible,
+	.base = 1,
+};
+
+static const struct sensor_template_group aquaero_set_point_template_group = {
+	.templates = aquaero_attributes_set_point_template,
+	.is_visible = aquaero_ctrl_is_visible,
+	.base = 1,
+};
+
+static const struct sensor_template_group aquaero_curve_template_group = {
+	.templates = aquaero_attributes_curve_template,
+	.is_visible = aquaero_ctrl_is_visible,
+	.base = 1,
+};
+
+/* Aquastream XT automatic fan mode parameters */
+enum aquastreamxt_auto_param {
+	AQUASTREAMXT_AUTO_TEMP_SRC,
+	AQUASTREAMXT_AUTO_TARGET,
+	AQUASTREAMXT_AUTO_P,
+	AQUASTREAMXT_AUTO_I,
+	AQUASTREAMXT_AUTO_D,
+	AQUASTREAMXT_AUTO_HYST,
+	AQUASTREAMXT_AUTO_MIN_TEMP,
+	AQUASTREAMXT_AUTO_MAX_TEMP,
+	AQUASTREAMXT_AUTO_MIN_PWM,
+	AQUASTREAMXT_AUTO_MAX_PWM,
+};
+
+static const struct {
+	int offset;
+	int type;
+} aquastreamxt_auto_params[] = {
+	[AQUASTREAMXT_AUTO_TEMP_SRC] = { AQUASTREAMXT_FAN_TEMP_SRC_OFFSET, AQC_8 },
+	[AQUASTREAMXT_AUTO_TARGET] = { AQUASTREAMXT_FAN_TARGET_TEMP_OFFSET, AQC_LE16 },
+	[AQUASTREAMXT_AUTO_P] = { AQUASTREAMXT_FAN_P_OFFSET, AQC_LE16 },
+	[AQUASTREAMXT_AUTO_I] = { AQUASTREAMXT_FAN_I_OFFSET, AQC_LE16 },
+	[AQUASTREAMXT_AUTO_D] = { AQUASTREAMXT_FAN_D_OFFSET, AQC_LE16 },
+	[AQUASTREAMXT_AUTO_HYST] = { AQUASTREAMXT_FAN_HYST_OFFSET, AQC_LE16 },
+	[AQUASTREAMXT_AUTO_MIN_TEMP] = { AQUASTREAMXT_FAN_MIN_TEMP_OFFSET, AQC_LE16 },
+	[AQUASTREAMXT_AUTO_MAX_TEMP] = { AQUASTREAMXT_FAN_MAX_TEMP_OFFSET, AQC_LE16 },
+	[AQUASTREAMXT_AUTO_MIN_PWM] = { AQUASTREAMXT_FAN_MIN_PWM_OFFSET, AQC_8 },
+	[AQUASTREAMXT_AUTO_MAX_PWM] = { AQUASTREAMXT_FAN_MAX_PWM_OFFSET, AQC_8 },
+};
+
+static ssize_t show_aquastreamxt_auto(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+	int param = sattr->index;
+	long val;
+	int ret = aqc_get_ctrl_val(priv, aquastreamxt_auto_params[param].offset, &val,
+				   aquastreamxt_auto_params[param].type);
+	if (ret < 0)
+		return ret;
+
+	switch (param) {
+	case AQUASTREAMXT_AUTO_TEMP_SRC:
+		/*
+		 * Temperature sensor, as the number of its temp entry. This assumes the device
+		 * numbers its sources in the order of the sensor report, so that source 0 is the
+		 * Fan IC sensor, which hasn't been confirmed on hardware
+		 */
+		val++;
+		break;
+	case AQUASTREAMXT_AUTO_TARGET:
+	case AQUASTREAMXT_AUTO_HYST:
+	case AQUASTREAMXT_AUTO_MIN_TEMP:
+	case AQUASTREAMXT_AUTO_MAX_TEMP:
+		val *= 10;
+		break;
+	case AQUASTREAMXT_AUTO_P:
+	case AQUASTREAMXT_AUTO_I:
+	case AQUASTREAMXT_AUTO_D:
+		val &= 0xFFFF;
+		break;
+	default:
+		break;
+	}
+
+	return sprintf(buf, "%ld\n", val);
+}
+
+static ssize_t
+store_aquastreamxt_auto(struct device *dev, struct device_attribute *attr, const char *buf,
+			size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+	int param = sattr->index;
+	long val;
+	int ret = kstrtol(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+
+	switch (param) {
+	case AQUASTREAMXT_AUTO_TEMP_SRC:
+		/* Same assumed mapping of sources to temp entries as when showing it */
+		if (val < 1 || val > priv->desc->num_temp_sensors)
+			return -EINVAL;
+		val--;
+		break;
+	case AQUASTREAMXT_AUTO_TARGET:
+	case AQUASTREAMXT_AUTO_HYST:
+	case AQUASTREAMXT_AUTO_MIN_TEMP:
+	case AQUASTREAMXT_AUTO_MAX_TEMP:
+		val = clamp_val(val, 0, 100000) / 10;
+		break;
+	case AQUASTREAMXT_AUTO_MIN_PWM:
+	case AQUASTREAMXT_AUTO_MAX_PWM:
+		if (val < 0 || val > 255)
+			return -EINVAL;
+		break;
+	default:
+		if (val < 0 || val > U16_MAX)
+			return -EINVAL;
+		break;
+	}
+
+	ret = aqc_set_ctrl_val(priv, aquastreamxt_auto_params[param].offset, val,
+			       aquastreamxt_auto_params[param].type);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static ssize_t show_aquastreamxt_hold_min(struct device *dev, struct device_attribute *attr,
+					  char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	long val;
+	int ret = aqc_get_ctrl_val(priv, AQUASTREAMXT_FAN_MODE_CTRL_OFFSET, &val, AQC_8);
+
+	if (ret < 0)
+		return ret;
+
+	return sprintf(buf, "%d\n", !!(val & AQUASTREAMXT_FAN_MODE_CTRL_HOLD_MIN));
+}
+
+static ssize_t
+store_aquastreamxt_hold_min(struct device *dev, struct device_attribute *attr, const char *buf,
+			    size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	long mode;
+	bool val;
+	int ret = kstrtobool(buf, &val);
+
+	if (ret < 0)
+		return ret;
+
+	ret = aqc_get_ctrl_val(priv, AQUASTREAMXT_FAN_MODE_CTRL_OFFSET, &mode, AQC_8);
+	if (ret < 0)
+		return ret;
+
+	if (val)
+		mode |= AQUASTREAMXT_FAN_MODE_CTRL_HOLD_MIN;
+	else
+		mode &= ~AQUASTREAMXT_FAN_MODE_CTRL_HOLD_MIN;
+
+	ret = aqc_set_ctrl_val(priv, AQUASTREAMXT_FAN_MODE_CTRL_OFFSET, mode, AQC_8);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+SENSOR_TEMPLATE_2(aquastreamxt_auto_temp_src, "pwm%d_auto_temp_src", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_TEMP_SRC);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_target, "pwm%d_auto_target_temp", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_TARGET);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_p, "pwm%d_auto_p", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_P);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_i, "pwm%d_auto_i", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_I);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_d, "pwm%d_auto_d", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_D);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_hyst, "pwm%d_auto_hyst", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_HYST);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_point1_temp, "pwm%d_auto_point1_temp", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_MIN_TEMP);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_point2_temp, "pwm%d_auto_point2_temp", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_MAX_TEMP);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_point1_pwm, "pwm%d_auto_point1_pwm", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_MIN_PWM);
+SENSOR_TEMPLATE_2(aquastreamxt_auto_point2_pwm, "pwm%d_auto_point2_pwm", 0644,
+		  show_aquastreamxt_auto, store_aquastreamxt_auto, 0, AQUASTREAMXT_AUTO_MAX_PWM);
+SENSOR_TEMPLATE(aquastreamxt_auto_hold_min, "pwm%d_auto_hold_min", 0644,
+		show_aquastreamxt_hold_min, store_aquastreamxt_hold_min, 0);
+
+static umode_t aquastreamxt_auto_is_visible(struct kobject *kobj, struct attribute *attr,
+					    int index)
+{
+	/* Created only for the fan of the Aquastream XT */
+	return attr->mode;
+}
+
+static struct sensor_device_template *aquastreamxt_attributes_auto_template[] = {
+	&sensor_dev_template_aquastreamxt_auto_temp_src,
+	&sensor_dev_template_aquastreamxt_auto_target,
+	&sensor_dev_template_aquastreamxt_auto_p,
+	&sensor_dev_template_aquastreamxt_auto_i,
+	&sensor_dev_template_aquastreamxt_auto_d,
+	&sensor_dev_template_aquastreamxt_auto_hyst,
+	&sensor_dev_template_aquastreamxt_auto_point1_temp,
+	&sensor_dev_template_aquastreamxt_auto_point2_temp,
+	&sensor_dev_template_aquastreamxt_auto_point1_pwm,
+	&sensor_dev_template_aquastreamxt_auto_point2_pwm,
+	&sensor_dev_template_aquastreamxt_auto_hold_min,
+	NULL
+};
+
+static const struct sensor_template_group aquastreamxt_auto_template_group = {
+	.templates = aquastreamxt_attributes_auto_template,
+	.is_visible = aquastreamxt_auto_is_visible,
+	.base = AQUASTREAMXT_FAN_CHANNEL + 1,
+};
+
+/* Sensor trends, in units of the sensor per minute */
+static ssize_t show_temp_rate(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	struct aqc_trend *trend = &priv->temp_trend[sattr->index];
+
+	if (aqc_update(priv) < 0 || !trend->valid)
+		return -ENODATA;
+
+	return sprintf(buf, "%d\n", trend->rate);
+}
+
+static ssize_t show_fan_rate(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	struct aqc_trend *trend = &priv->speed_trend[sattr->index];
+
+	if (aqc_update(priv) < 0 || !trend->valid)
+		return -ENODATA;
+
+	return sprintf(buf, "%d\n", trend->rate);
+}
+
+/* History of readings not covered by the hwmon core */
+static ssize_t show_temp_average(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	long val;
+	int ret;
+
+	ret = aqc_read_history(priv, &priv->temp_history[sattr->index], AQC_HISTORY_AVERAGE, &val);
+	if (ret < 0)
+		return ret;
+
+	return sprintf(buf, "%ld\n", val);
+}
+
+static ssize_t show_fan_history(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+	long val;
+	int ret;
+
+	ret = aqc_read_history(priv, &priv->speed_history[sattr->nr], sattr->index, &val);
+	if (ret < 0)
+		return ret;
+
+	return sprintf(buf, "%ld\n", val);
+}
+
+static ssize_t
+store_fan_reset_history(struct device *dev, struct device_attribute *attr, const char *buf,
+			size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+
+	aqc_reset_channel_history(priv, &priv->speed_history[sattr->nr],
+				  priv->speed_input[sattr->nr]);
+
+	return count;
+}
+
+SENSOR_TEMPLATE(temp_rate, "temp%d_rate", 0444, show_temp_rate, NULL, 0);
+SENSOR_TEMPLATE(temp_average, "temp%d_average", 0444, show_temp_average, NULL, 0);
+SENSOR_TEMPLATE(fan_rate, "fan%d_rate", 0444, show_fan_rate, NULL, 0);
+SENSOR_TEMPLATE_2(fan_lowest, "fan%d_lowest", 0444, show_fan_history, NULL, 0,
+		  AQC_HISTORY_LOWEST);
+SENSOR_TEMPLATE_2(fan_highest, "fan%d_highest", 0444, show_fan_history, NULL, 0,
+		  AQC_HISTORY_HIGHEST);
+SENSOR_TEMPLATE_2(fan_average, "fan%d_average", 0444, show_fan_history, NULL, 0,
+		  AQC_HISTORY_AVERAGE);
+SENSOR_TEMPLATE_2(fan_reset_history, "fan%d_reset_history", 0200, NULL,
+		  store_fan_reset_history, 0, 0);
+
+static struct sensor_device_template *aqc_attributes_temp_trend_template[] = {
+	&sensor_dev_template_temp_rate,
+	&sensor_dev_template_temp_average,
+	NULL
+};
+
+static struct sensor_device_template *aqc_attributes_fan_trend_template[] = {
+	&sensor_dev_template_fan_rate,
+	&sensor_dev_template_fan_lowest,
+	&sensor_dev_template_fan_highest,
+	&sensor_dev_template_fan_average,
+	&sensor_dev_template_fan_reset_history,
+	NULL
+};
+
+/* Trends and history follow the visibility of the readings they are derived from */
+static umode_t aqc_temp_trend_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	struct aqc_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+	int channel = index / (ARRAY_SIZE(aqc_attributes_temp_trend_template) - 1);
+
+	if (!aqc_is_visible(priv, hwmon_temp, hwmon_temp_input, channel))
+		return 0;
+
+	return attr->mode;
+}
+
+static umode_t aqc_fan_trend_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	struct aqc_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+	int channel = index / (ARRAY_SIZE(aqc_attributes_fan_trend_template) - 1);
+
+	if (!aqc_is_visible(priv, hwmon_fan, hwmon_fan_input, channel))
+		return 0;
+
+	return attr->mode;
+}
+
+static const struct sensor_template_group aqc_temp_trend_template_group = {
+	.templates = aqc_attributes_temp_trend_template,
+	.is_visible = aqc_temp_trend_is_visible,
+	.base = 1,
+};
+
+static const struct sensor_template_group aqc_fan_trend_template_group = {
+	.templates = aqc_attributes_fan_trend_template,
+	.is_visible = aqc_fan_trend_is_visible,
+	.base = 1,
+};
+
+/* Coolant volume pumped through flow channels */
+static ssize_t show_fan_volume(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	unsigned long flags;
+	u64 total;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	total = priv->volume[sattr->index].total;
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+
+	/* From dL/h times ms to mL */
+	return sprintf(buf, "%llu\n", div_u64(total, 36000));
+}
+
+static ssize_t
+store_fan_volume_reset(struct device *dev, struct device_attribute *attr, const char *buf,
+		       size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	priv->volume[sattr->index].total = 0;
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+
+	return count;
+}
+
+SENSOR_TEMPLATE(fan_volume, "fan%d_volume", 0444, show_fan_volume, NULL, 0);
+SENSOR_TEMPLATE(fan_volume_reset, "fan%d_volume_reset", 0200, NULL, store_fan_volume_reset, 0);
+
+static struct sensor_device_template *aqc_attributes_volume_template[] = {
+	&sensor_dev_template_fan_volume,
+	&sensor_dev_template_fan_volume_reset,
+	NULL
+};
+
+static umode_t aqc_volume_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	struct aqc_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+	int channel = index / (ARRAY_SIZE(aqc_attributes_volume_template) - 1);
+
+	if (!aqc_is_flow_channel(priv, channel) ||
+	    !aqc_is_visible(priv, hwmon_fan, hwmon_fan_input, channel))
+		return 0;
+
+	return attr->mode;
+}
+
+static const struct sensor_template_group aqc_volume_template_group = {
+	.templates = aqc_attributes_volume_template,
+	.is_visible = aqc_volume_is_visible,
+	.base = 1,
+};
+
+/* Control report profile slots */
+static ssize_t show_profile_name(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	ssize_t ret;
+
+	mutex_lock(&priv->mutex);
+	ret = sprintf(buf, "%s\n", priv->profiles[sattr->index].name);
+	mutex_unlock(&priv->mutex);
+
+	return ret;
+}
+
+static ssize_t
+store_profile_name(struct device *dev, struct device_attribute *attr, const char *buf,
+		   size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	char input[64], *name;
+	unsigned int dummy;
+
+	/* Leave room for surrounding whitespace, which is dropped */
+	if (strscpy(input, buf, sizeof(input)) < 0)
+		return -EINVAL;
+
+	/* Longer names are refused rather than silently cut short */
+	name = strim(input);
+	if (strlen(name) > AQC_PROFILE_NAME_LEN - 1)
+		return -EINVAL;
+
+	/* Names must not be mistaken for slot numbers when applying a profile */
+	if (name[0] == '\0' || !kstrtouint(name, 10, &dummy))
+		return -EINVAL;
+
+	mutex_lock(&priv->mutex);
+	strscpy(priv->profiles[sattr->index].name, name, AQC_PROFILE_NAME_LEN);
+	mutex_unlock(&priv->mutex);
+
+	return count;
+}
+
+static ssize_t
+store_profile_save(struct device *dev, struct device_attribute *attr, const char *buf,
+		   size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	struct aqc_profile_slot *slot = &priv->profiles[sattr->index];
+	unsigned long val;
+	int ret = kstrtoul(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val != 1)
+		return -EINVAL;
+
+	mutex_lock(&priv->mutex);
+
+	if (!slot->report) {
+		slot->report = devm_kmalloc(&priv->hdev->dev, priv->buffer_size, GFP_KERNEL);
+		if (!slot->report) {
+			ret = -ENOMEM;
+			goto unlock_and_return;
+		}
+	}
+
+	ret = aqc_get_ctrl_data(priv);
+	if (ret < 0)
+		goto unlock_and_return;
+
+	/* Only keep images that can later be applied as they are */
+	if (!aqc_ctrl_report_valid(priv, priv->buffer)) {
+		ret = -EIO;
+		goto unlock_and_return;
+	}
+
+	memcpy(slot->report, priv->buffer, priv->buffer_size);
+	slot->valid = true;
+
+unlock_and_return:
+	mutex_unlock(&priv->mutex);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+SENSOR_TEMPLATE(profile_name, "profile%d_name", 0644, show_profile_name, store_profile_name, 0);
+SENSOR_TEMPLATE(profile_save, "profile%d_save", 0200, NULL, store_profile_save, 0);
+
+static umode_t aqc_profile_slots_is_visible(struct kobject *kobj, struct attribute *attr,
+					    int index)
+{
+	/* Slots are only created for devices with a control report */
+	return attr->mode;
+}
+
+static struct sensor_device_template *aqc_attributes_profile_slots_template[] = {
+	&sensor_dev_template_profile_name,
+	&sensor_dev_template_profile_save,
+	NULL
+};
+
+static const struct sensor_template_group aqc_profile_slots_template_group = {
+	.templates = aqc_attributes_profile_slots_template,
+	.is_visible = aqc_profile_slots_is_visible,
+	.base = 1,
+};
+
+/* PWM ramp rates */
+static ssize_t show_pwm_ramp_rate(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+
+	return sprintf(buf, "%u\n", priv->pwm_ramps[sattr->index].rate);
+}
+
+static ssize_t
+store_pwm_ramp_rate(struct device *dev, struct device_attribute *attr, const char *buf,
+		    size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
+	unsigned long val;
+	int ret = kstrtoul(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val > 255 * 1000 / AQC_PWM_RAMP_INTERVAL)
+		return -EINVAL;
+
+	spin_lock(&priv->pwm_ramp_lock);
+	priv->pwm_ramps[sattr->index].rate = val;
+	/* Disabling ramping leaves the channel at the current step */
+	if (val == 0) {
+		priv->pwm_ramps[sattr->index].active = false;
+		priv->pwm_ramps[sattr->index].current_pwm = -1;
+	}
+	spin_unlock(&priv->pwm_ramp_lock);
+
+	return count;
+}
+
+SENSOR_TEMPLATE(pwm_ramp_rate, "pwm%d_ramp_rate", 0644, show_pwm_ramp_rate,
+		store_pwm_ramp_rate, 0);
+
+static umode_t aqc_pwm_ramp_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	/* Created only for channels with PWM control */
+	return attr->mode;
+}
+
+static struct sensor_device_template *aqc_attributes_pwm_ramp_template[] = {
+	&sensor_dev_template_pwm_ramp_rate,
+	NULL
+};
+
+static const struct sensor_template_group aqc_pwm_ramp_template_group = {
+	.templates = aqc_attributes_pwm_ramp_template,
+	.is_visible = aqc_pwm_ramp_is_visible,
+	.base = 1,
+};
+
+static ssize_t profile_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	ssize_t ret;
+
+	mutex_lock(&priv->mutex);
+	if (priv->active_profile < 0)
+		ret = sprintf(buf, "none\n");
+	else if (priv->profiles[priv->active_profile].name[0] == '\0')
+		ret = sprintf(buf, "%d\n", priv->active_profile + 1);
+	else
+		ret = sprintf(buf, "%s\n", priv->profiles[priv->active_profile].name);
+	mutex_unlock(&priv->mutex);
+
+	return ret;
+}
+
+/* Accepts either the slot number or its name */
+static int aqc_find_profile(struct aqc_data *priv, const char *buf)
+{
+	unsigned int slot;
+	int i;
+
+	if (!kstrtouint(buf, 10, &slot)) {
+		if (slot < 1 || slot > AQC_NUM_PROFILE_SLOTS)
+			return -EINVAL;
+		return slot - 1;
+	}
+
+	for (i = 0; i < AQC_NUM_PROFILE_SLOTS; i++)
+		if (priv->profiles[i].name[0] != '\0' && sysfs_streq(buf, priv->profiles[i].name))
+			return i;
+
+	return -EINVAL;
+}
+
+static ssize_t profile_store(struct device *dev, struct device_attribute *attr, const char *buf,
+			     size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	int ret, slot;
+
+	mutex_lock(&priv->mutex);
+
+	slot = aqc_find_profile(priv, buf);
+	if (slot < 0) {
+		ret = slot;
+		goto unlock_and_return;
+	}
+
+	if (!priv->profiles[slot].valid) {
+		ret = -ENODATA;
+		goto unlock_and_return;
+	}
+
+	/* The image was validated when saved, so send it without reading the report first */
+	memcpy(priv->buffer, priv->profiles[slot].report, priv->buffer_size);
+	ret = aqc_send_ctrl_data(priv, true);
+	if (ret < 0)
+		goto unlock_and_return;
+
+	priv->active_profile = slot;
+
+unlock_and_return:
+	mutex_unlock(&priv->mutex);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(profile);
+
+/* PWM values of all channels, read and written in a single control report transaction */
+static ssize_t pwm_all_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	long vals[AQC_MAX_PWM_CHANNELS];
+	int ret, i, len = 0;
+
+	ret = aqc_get_pwm_vals(priv, 0, vals, priv->desc->num_fans);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < priv->desc->num_fans; i++)
+		len += sprintf(buf + len, "%s%ld", i ? " " : "", vals[i]);
+
+	return len + sprintf(buf + len, "\n");
+}
+
+/* Expects one value per channel, where "-" leaves the channel unchanged */
+static ssize_t pwm_all_store(struct device *dev, struct device_attribute *attr, const char *buf,
+			     size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	int offsets[AQC_MAX_PWM_CHANNELS * AQC_PWM_MAX_CTRL_VALS];
+	long values[AQC_MAX_PWM_CHANNELS * AQC_PWM_MAX_CTRL_VALS];
+	int types[AQC_MAX_PWM_CHANNELS * AQC_PWM_MAX_CTRL_VALS];
+	char input[64], *cur, *token;
+	int ret, channel = 0, len = 0;
+	unsigned long val;
+
+	if (strscpy(input, buf, sizeof(input)) < 0)
+		return -EINVAL;
+
+	cur = strim(input);
+	while ((token = strsep(&cur, " \t")) != NULL) {
+		if (*token == '\0')
+			continue;
+
+		if (channel >= priv->desc->num_fans)
+			return -EINVAL;
+
+		if (strcmp(token, "-") != 0) {
+			ret = kstrtoul(token, 10, &val);
+			if (ret < 0)
+				return ret;
+			if (val > 255)
+				return -EINVAL;
+
+			len += aqc_pwm_to_ctrl_vals(priv, channel, val, offsets + len,
+						    values + len, types + len);
+			aqc_stop_pwm_ramp(priv, channel);
+		}
+		channel++;
+	}
+
+	if (channel != priv->desc->num_fans)
+		return -EINVAL;
+
+	if (len == 0)
+		return count;
+
+	ret = aqc_set_pwm_ctrl_vals(priv, offsets, values, types, len);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(pwm_all);
+
+static ssize_t pwm_volatile_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", priv->pwm_volatile);
+}
+
+static ssize_t pwm_volatile_store(struct device *dev, struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	bool val;
+	int ret = kstrtobool(buf, &val);
+
+	if (ret < 0)
+		return ret;
+
+	priv->pwm_volatile = val;
+
+	return count;
+}
+
+static ssize_t commit_store(struct device *dev, struct device_attribute *attr, const char *buf,
+			    size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned long val;
+	int ret = kstrtoul(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val != 1)
+		return -EINVAL;
+
+	mutex_lock(&priv->mutex);
+	if (priv->ctrl_report_unsaved)
+		ret = aqc_save_ctrl_data(priv);
+	mutex_unlock(&priv->mutex);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(pwm_volatile);
+static DEVICE_ATTR_WO(commit);
+
+static ssize_t ctrl_report_delay_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", priv->ctrl_report_delay);
+}
+
+static ssize_t ctrl_report_delay_store(struct device *dev, struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned long val;
+	int ret = kstrtoul(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val > CTRL_REPORT_DELAY_MAX)
+		return -EINVAL;
+
+	mutex_lock(&priv->mutex);
+	priv->ctrl_report_delay = val;
+	mutex_unlock(&priv->mutex);
+
+	return count;
+}
+
+static ssize_t ctrl_report_calibrate_store(struct device *dev, struct device_attribute *attr,
+					   const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned long val;
+	int ret = kstrtoul(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val != 1)
+		return -EINVAL;
+
+	mutex_lock(&priv->mutex);
+	ret = aqc_calibrate_ctrl_report_delay(priv);
+	mutex_unlock(&priv->mutex);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static ssize_t ctrl_report_requests_show(struct device *dev, struct device_attribute *attr,
+					 char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%lu\n", priv->ctrl_report_requests);
+}
+
+static ssize_t ctrl_report_errors_show(struct device *dev, struct device_attribute *attr,
+				       char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%lu\n", priv->ctrl_report_errors);
+}
+
+static ssize_t ctrl_report_retries_show(struct device *dev, struct device_attribute *attr,
+					char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%lu\n", priv->ctrl_report_retries);
+}
+
+static ssize_t link_health_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	/* Like the counters, read without waiting for a request that may be stuck retrying */
+	return sprintf(buf, "%s\n", aqc_link_health_names[READ_ONCE(priv->link_health)]);
+}
+
+static ssize_t ctrl_report_conflicts_show(struct device *dev, struct device_attribute *attr,
+					  char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%lu\n", priv->ctrl_report_conflicts);
+}
+
+/* Shows the seconds left on the lease, 0 if there is none */
+static ssize_t ctrl_lease_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned int val = 0;
+
+	mutex_lock(&priv->mutex);
+	if (aqc_ctrl_report_leased(priv))
+		val = DIV_ROUND_UP(jiffies_to_msecs(priv->ctrl_lease_expires - jiffies), 1000);
+	mutex_unlock(&priv->mutex);
+
+	return sprintf(buf, "%u\n", val);
+}
+
+/* Grants hidraw users the control report for the given seconds, 0 ends the lease */
+static ssize_t ctrl_lease_store(struct device *dev, struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned int val;
+	int ret = kstrtouint(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val > CTRL_REPORT_LEASE_MAX)
+		return -EINVAL;
+
+	mutex_lock(&priv->mutex);
+	priv->ctrl_lease_expires = val ? jiffies + val * HZ : 0;
+	mutex_unlock(&priv->mutex);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(ctrl_report_delay);
+static DEVICE_ATTR_WO(ctrl_report_calibrate);
+static DEVICE_ATTR_RO(ctrl_report_requests);
+static DEVICE_ATTR_RO(ctrl_report_errors);
+static DEVICE_ATTR_RO(ctrl_report_retries);
+static DEVICE_ATTR_RO(link_health);
+static DEVICE_ATTR_RO(ctrl_report_conflicts);
+static DEVICE_ATTR_RW(ctrl_lease);
+
+static const char *const aqc_virt_sensor_type_names[] = {
+	[AQC_VIRT_SENSOR_DISABLED] = "off",
+	[AQC_VIRT_SENSOR_TEMP] = "temp",
+	[AQC_VIRT_SENSOR_PERCENT] = "percent",
+	[AQC_VIRT_SENSOR_POWER] = "power",
+};
+
+/* Shows the enabled virtual sensors as index:type:value */
+static ssize_t virtual_sensors_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	int i, len = 0;
+	long val;
+	u8 type;
+
+	mutex_lock(&priv->mutex);
+	for (i = 0; i < AQC_VIRT_SENSORS_NUM; i++) {
+		type = priv->virt_sensors_buffer[AQC_VIRT_SENSORS_TYPES_OFFSET + i];
+		if (type == AQC_VIRT_SENSOR_DISABLED)
+			continue;
+
+		val = (s16)get_unaligned_be16(priv->virt_sensors_buffer +
+					      AQC_VIRT_SENSORS_VALUES_OFFSET + i * AQC_SENSOR_SIZE);
+		switch (type) {
+		case AQC_VIRT_SENSOR_TEMP:
+			val *= 10;
+			break;
+		case AQC_VIRT_SENSOR_POWER:
+			val *= 10000;
+			break;
+		default:
+			break;
+		}
+
+		len += sprintf(buf + len, "%s%d:%s:%ld", len ? " " : "", i + 1,
+			       aqc_virt_sensor_type_names[type], val);
+	}
+	mutex_unlock(&priv->mutex);
+
+	return len + sprintf(buf + len, "\n");
+}
+
+/*
+ * Expects space separated index:type:value entries, where type is temp (in millidegrees),
+ * percent (in hundredths of a percent), power (in microwatts) or off, which takes no value.
+ * Sensors that aren't listed keep their values.
+ */
+static ssize_t virtual_sensors_store(struct device *dev, struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	u8 types[AQC_VIRT_SENSORS_NUM];
+	u16 vals[AQC_VIRT_SENSORS_NUM];
+	char input[512], *cur, *token, *field;
+	unsigned int index;
+	int ret, i, type;
+	u16 changed = 0;
+	long val;
+
+	if (strscpy(input, buf, sizeof(input)) < 0)
+		return -EINVAL;
+
+	cur = strim(input);
+	while ((token = strsep(&cur, " \t")) != NULL) {
+		if (*token == '\0')
+			continue;
+
+		field = strsep(&token, ":");
+		ret = kstrtouint(field, 10, &index);
+		if (ret < 0)
+			return ret;
+		if (index < 1 || index > AQC_VIRT_SENSORS_NUM || !token)
+			return -EINVAL;
+		index--;
+
+		field = strsep(&token, ":");
+		type = match_string(aqc_virt_sensor_type_names,
+				    ARRAY_SIZE(aqc_virt_sensor_type_names), field);
+		if (type < 0)
+			return -EINVAL;
+
+		if (type == AQC_VIRT_SENSOR_DISABLED) {
+			if (token)
+				return -EINVAL;
+			val = AQC_SENSOR_NA;
+		} else {
+			if (!token)
+				return -EINVAL;
+			ret = kstrtol(token, 10, &val);
+			if (ret < 0)
+				return ret;
+
+			switch (type) {
+			case AQC_VIRT_SENSOR_TEMP:
+				val = DIV_ROUND_CLOSEST(val, 10);
+				break;
+			case AQC_VIRT_SENSOR_POWER:
+				val = DIV_ROUND_CLOSEST(val, 10000);
+				break;
+			default:
+				break;
+			}
+
+			if (val < S16_MIN || val >= AQC_SENSOR_NA)
+				return -EINVAL;
+		}
+
+		types[index] = type;
+		vals[index] = val;
+		changed |= BIT(index);
+	}
+
+	if (!changed)
+		return -EINVAL;
+
+	mutex_lock(&priv->mutex);
+	for (i = 0; i < AQC_VIRT_SENSORS_NUM; i++) {
+		if (!(changed & BIT(i)))
+			continue;
+
+		priv->virt_sensors_buffer[AQC_VIRT_SENSORS_TYPES_OFFSET + i] = types[i];
+		put_unaligned_be16(vals[i], priv->virt_sensors_buffer +
+				   AQC_VIRT_SENSORS_VALUES_OFFSET + i * AQC_SENSOR_SIZE);
+	}
+	mutex_unlock(&priv->mutex);
+
+	aqc_schedule_virt_sensors(priv);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(virtual_sensors);
+
+/* Aquastream XT alarm settings */
+static ssize_t alarm_mask_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	long val;
+	int ret = aqc_get_ctrl_val(priv, AQUASTREAMXT_ALARM_CONFIG_OFFSET, &val, AQC_8);
+
+	if (ret < 0)
+		return ret;
+
+	return sprintf(buf, "0x%02lx\n", val);
+}
+
+static ssize_t alarm_mask_store(struct device *dev, struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	u8 val;
+	int ret = kstrtou8(buf, 0, &val);
+
+	if (ret < 0)
+		return ret;
+
+	ret = aqc_set_ctrl_val(priv, AQUASTREAMXT_ALARM_CONFIG_OFFSET, val, AQC_8);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static ssize_t alarm_flow_speed_show(struct device *dev, struct device_attribute *attr,
+				     char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	long val;
+	int ret = aqc_get_ctrl_val(priv, AQUASTREAMXT_ALARM_FLOW_SPEED_OFFSET, &val, AQC_LE16);
+
+	if (ret < 0)
+		return ret;
+
+	return sprintf(buf, "%ld\n", val & 0xFFFF);
+}
+
+static ssize_t alarm_flow_speed_store(struct device *dev, struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	u16 val;
+	int ret = kstrtou16(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+
+	ret = aqc_set_ctrl_val(priv, AQUASTREAMXT_ALARM_FLOW_SPEED_OFFSET, val, AQC_LE16);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(alarm_mask);
+static DEVICE_ATTR_RW(alarm_flow_speed);
+
+/* Profile stored on the device itself, switched by changing a single control report byte */
+static ssize_t device_profile_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	long val;
+	int ret = aqc_get_ctrl_val(priv, priv->profile_ctrl_offset, &val, AQC_8);
+
+	if (ret < 0)
+		return ret;
+
+	return sprintf(buf, "%ld\n", val + 1);
+}
+
+static ssize_t device_profile_store(struct device *dev, struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned int val;
+	int ret = kstrtouint(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val < 1 || val > AQC_NUM_DEVICE_PROFILES)
+		return -EINVAL;
+
+	ret = aqc_set_ctrl_val(priv, priv->profile_ctrl_offset, val - 1, AQC_8);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(device_profile);
+
+/* Sensor report statistics */
+static ssize_t reports_received_show(struct device *dev, struct device_attribute *attr,
+				     char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned long flags, val;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	val = priv->reports_received;
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+
+	return sprintf(buf, "%lu\n", val);
+}
+
+static ssize_t report_gaps_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned long flags, val;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	val = priv->report_gaps;
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+
+	return sprintf(buf, "%lu\n", val);
+}
+
+/* Shows the number of intervals per jitter bucket, from the lowest one */
+static ssize_t report_jitter_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned long vals[AQC_REPORT_JITTER_BUCKETS];
+	unsigned long flags;
+	int i, len = 0;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	memcpy(vals, priv->report_jitter, sizeof(vals));
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+
+	for (i = 0; i < AQC_REPORT_JITTER_BUCKETS; i++)
+		len += sprintf(buf + len, "%s%lu", i ? " " : "", vals[i]);
+
+	return len + sprintf(buf + len, "\n");
+}
+
+static ssize_t idle_timeout_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(priv->idle_timeout));
+}
+
+/* Enables idle mode with the given timeout in seconds, 0 disables it and reopens the device */
+static ssize_t idle_timeout_store(struct device *dev, struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	unsigned int val;
+	int ret = kstrtouint(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	if (val > AQC_IDLE_TIMEOUT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&priv->idle_mutex);
+	priv->idle_timeout = val;
+	priv->last_access = jiffies;
+	if (!val)
+		ret = aqc_idle_wake(priv);
+	else
+		mod_delayed_work(system_wq, &priv->idle_work, val * HZ);
+	mutex_unlock(&priv->idle_mutex);
+
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static ssize_t idle_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", READ_ONCE(priv->idle));
+}
+
+static DEVICE_ATTR_RO(reports_received);
+static DEVICE_ATTR_RO(report_gaps);
+static DEVICE_ATTR_RO(report_jitter);
+static DEVICE_ATTR_RW(idle_timeout);
+static DEVICE_ATTR_RO(idle);
+
+/*
+ * Device info, cached from the last sensor report. These never wait for the device, so
+ * info_age and info_stale tell how current the values are
+ */
+static s64 aqc_info_age(struct aqc_data *priv)
+{
+	unsigned long flags;
+	ktime_t last;
+
+	spin_lock_irqsave(&priv->history_lock, flags);
+	last = priv->last_report;
+	spin_unlock_irqrestore(&priv->history_lock, flags);
+
+	if (!last)
+		return -ENODATA;
+
+	return ktime_ms_delta(ktime_get(), last);
+}
+
+static ssize_t serial_number_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (aqc_info_age(priv) < 0)
+		return -ENODATA;
+
+	return sprintf(buf, "%05u-%05u\n", priv->serial_number[0], priv->serial_number[1]);
+}
+
+static ssize_t firmware_version_show(struct device *dev, struct device_attribute *attr,
+				     char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (aqc_info_age(priv) < 0)
+		return -ENODATA;
+
+	return sprintf(buf, "%u\n", priv->firmware_version);
+}
+
+static ssize_t power_cycles_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (aqc_info_age(priv) < 0)
+		return -ENODATA;
+
+	return sprintf(buf, "%u\n", priv->power_cycles);
+}
+
+static ssize_t hw_version_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (!completion_done(&priv->aquaero_sensor_report_received))
+		return -ENODATA;
+
+	return sprintf(buf, "%u\n", priv->aquaero_hw_version);
+}
+
+static ssize_t current_uptime_show(struct device *dev, struct device_attribute *attr,
+				   char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (!completion_done(&priv->aquaero_sensor_report_received))
+		return -ENODATA;
+
+	return sprintf(buf, "%u\n", priv->current_uptime);
+}
+
+static ssize_t total_uptime_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (!completion_done(&priv->aquaero_sensor_report_received))
+		return -ENODATA;
+
+	return sprintf(buf, "%u\n", priv->total_uptime);
+}
+
+/* Milliseconds since the cached values were last updated */
+static ssize_t info_age_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	s64 age = aqc_info_age(priv);
+
+	if (age < 0)
+		return age;
+
+	return sprintf(buf, "%lld\n", age);
+}
+
+/* Values older than the update interval are stale, same as for hwmon reads */
+static ssize_t info_stale_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct aqc_data *priv = dev_get_drvdata(dev);
+	s64 age = aqc_info_age(priv);
+
+	return sprintf(buf, "%d\n", age < 0 || age > jiffies_to_msecs(STATUS_UPDATE_INTERVAL));
+}
+
+static DEVICE_ATTR_RO(serial_number);
+static DEVICE_ATTR_RO(firmware_version);
+static DEVICE_ATTR_RO(power_cycles);
+static DEVICE_ATTR_RO(hw_version);
+static DEVICE_ATTR_RO(current_uptime);
+static DEVICE_ATTR_RO(total_uptime);
+static DEVICE_ATTR_RO(info_age);
+static DEVICE_ATTR_RO(info_stale);
+
+static struct attribute *aqc_info_attrs[] = {
+	&dev_attr_serial_number.attr,
+	&dev_attr_firmware_version.attr,
+	&dev_attr_power_cycles.attr,
+	&dev_attr_hw_version.attr,
+	&dev_attr_current_uptime.attr,
+	&dev_attr_total_uptime.attr,
+	&dev_attr_info_age.attr,
+	&dev_attr_info_stale.attr,
+	NULL
+};
+
+static umode_t aqc_info_attrs_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if (attr == &dev_attr_serial_number.attr && !priv->desc->serial_number_start_offset)
+		return 0;
+
+	if (attr == &dev_attr_firmware_version.attr && !priv->desc->firmware_version_offset)
+		return 0;
+
+	if (attr == &dev_attr_power_cycles.attr && !priv->desc->power_cycle_count_offset)
+		return 0;
+
+	if ((attr == &dev_attr_hw_version.attr ||
+	     attr == &dev_attr_current_uptime.attr ||
+	     attr == &dev_attr_total_uptime.attr) && priv->kind != aquaero)
+		return 0;
+
+	return attr->mode;
+}
+
+static const struct attribute_group aqc_info_attr_group = {
+	.attrs = aqc_info_attrs,
+	.is_visible = aqc_info_attrs_is_visible,
+};
+
+static struct attribute *aqc_ctrl_attrs[] = {
+	&dev_attr_profile.attr,
+	&dev_attr_pwm_all.attr,
+	&dev_attr_pwm_volatile.attr,
+	&dev_attr_commit.attr,
+	&dev_attr_ctrl_report_delay.attr,
+	&dev_attr_ctrl_report_calibrate.attr,
+	&dev_attr_ctrl_report_requests.attr,
+	&dev_attr_ctrl_report_errors.attr,
+	&dev_attr_ctrl_report_retries.attr,
+	&dev_attr_link_health.attr,
+	&dev_attr_ctrl_report_conflicts.attr,
+	&dev_attr_ctrl_lease.attr,
+	&dev_attr_virtual_sensors.attr,
+	&dev_attr_alarm_mask.attr,
+	&dev_attr_alarm_flow_speed.attr,
+	&dev_attr_device_profile.attr,
+	&dev_attr_reports_received.attr,
+	&dev_attr_report_gaps.attr,
+	&dev_attr_report_jitter.attr,
+	&dev_attr_idle_timeout.attr,
+	&dev_attr_idle.attr,
+	NULL
+};
+
+static umode_t aqc_ctrl_attrs_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct aqc_data *priv = dev_get_drvdata(dev);
+
+	if ((attr == &dev_attr_profile.attr ||
+	     attr == &dev_attr_ctrl_report_delay.attr ||
+	     attr == &dev_attr_ctrl_report_calibrate.attr ||
+	     attr == &dev_attr_ctrl_report_requests.attr ||
+	     attr == &dev_attr_ctrl_report_errors.attr ||
+	     attr == &dev_attr_ctrl_report_retries.attr ||
+	     attr == &dev_attr_link_health.attr ||
+	     attr == &dev_attr_ctrl_report_conflicts.attr ||
+	     attr == &dev_attr_ctrl_lease.attr) && !aqc_has_ctrl_report(priv))
+		return 0;
+
+	if ((attr == &dev_attr_pwm_all.attr ||
+	     attr == &dev_attr_pwm_volatile.attr ||
+	     attr == &dev_attr_commit.attr) && !priv->fan_ctrl_offsets)
+		return 0;
+
+	if (attr == &dev_attr_virtual_sensors.attr && !aqc_has_virt_sensors_transfer(priv))
+		return 0;
+
+	if ((attr == &dev_attr_alarm_mask.attr ||
+	     attr == &dev_attr_alarm_flow_speed.attr) && priv->kind != aquastreamxt)
+		return 0;
+
+	if (attr == &dev_attr_device_profile.attr && !priv->profile_ctrl_offset)
+		return 0;
+
+	/* Legacy devices are read on demand, so there is no report stream to watch or close */
+	if ((attr == &dev_attr_reports_received.attr ||
+	     attr == &dev_attr_report_gaps.attr ||
+	     attr == &dev_attr_report_jitter.attr ||
+	     attr == &dev_attr_idle_timeout.attr ||
+	     attr == &dev_attr_idle.attr) && priv->status_report_id != 0)
+		return 0;
+
+	return attr->mode;
+}
+
+static const struct attribute_group aqc_ctrl_attr_group = {
+	.attrs = aqc_ctrl_attrs,
+	.is_visible = aqc_ctrl_attrs_is_visible,
+};
+
+static const struct hwmon_ops aqc_hwmon_ops = {
+	.is_visible = aqc_is_visible,
+	.read = aqc_read,
+	.read_string = aqc_read_string,
+	.write = aqc_write
+};
+
+#define AQC_TEMP_HISTORY	(HWMON_T_LOWEST | HWMON_T_HIGHEST | HWMON_T_RESET_HISTORY)
+#define AQC_POWER_HISTORY	(HWMON_P_AVERAGE | HWMON_P_INPUT_LOWEST | HWMON_P_INPUT_HIGHEST | \
+				 HWMON_P_RESET_HISTORY)
+
+/* Every channel and attribute any device has, trimmed per device by aqc_build_info() */
+static const struct hwmon_channel_info * const aqc_info[] = {
+	HWMON_CHANNEL_INFO(chip,
+			   HWMON_C_TEMP_RESET_HISTORY | HWMON_C_POWER_RESET_HISTORY),
+	HWMON_CHANNEL_INFO(temp,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET |
+			   HWMON_T_MAX,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET |
+			   HWMON_T_MAX,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL,
+			   AQC_TEMP_HISTORY | HWMON_T_INPUT | HWMON_T_LABEL),
+	HWMON_CHANNEL_INFO(fan,
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX |
+			   HWMON_F_TARGET,
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX,
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX,
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX,
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_PULSES,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_PULSES,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL,
+			   HWMON_F_INPUT | HWMON_F_LABEL),
+	HWMON_CHANNEL_INFO(power,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY,
+			   HWMON_P_INPUT | HWMON_P_LABEL | AQC_POWER_HISTORY),
+#if KERNEL_VERSION(6, 16, 0) <= LINUX_VERSION_CODE
+	HWMON_CHANNEL_INFO(energy64,
+#else
+	HWMON_CHANNEL_INFO(energy,
+#endif
+			   HWMON_E_INPUT | HWMON_E_LABEL,
+			   HWMON_E_INPUT | HWMON_E_LABEL,
+			   HWMON_E_INPUT | HWMON_E_LABEL,
+			   HWMON_E_INPUT | HWMON_E_LABEL,
+			   HWMON_E_INPUT | HWMON_E_LABEL,
+			   HWMON_E_INPUT | HWMON_E_LABEL,
+			   HWMON_E_INPUT | HWMON_E_LABEL,
+			   HWMON_E_INPUT | HWMON_E_LABEL),
+	HWMON_CHANNEL_INFO(pwm,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
+			   HWMON_PWM_MODE,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
+			   HWMON_PWM_MODE,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
+			   HWMON_PWM_MODE,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
+			   HWMON_PWM_MODE,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP,
+			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP),
+	HWMON_CHANNEL_INFO(in,
+			   HWMON_I_INPUT | HWMON_I_LABEL,
+			   HWMON_I_INPUT | HWMON_I_LABEL,
+			   HWMON_I_INPUT | HWMON_I_LABEL,
+			   HWMON_I_INPUT | HWMON_I_LABEL,
+			   HWMON_I_INPUT | HWMON_I_LABEL,
+			   HWMON_I_INPUT | HWMON_I_LABEL,
+			   HWMON_I_INPUT | HWMON_I_LABEL,
+			   HWMON_I_INPUT | HWMON_I_LABEL),
+	HWMON_CHANNEL_INFO(curr,
+			   HWMON_C_INPUT | HWMON_C_LABEL,
+			   HWMON_C_INPUT | HWMON_C_LABEL,
+			   HWMON_C_INPUT | HWMON_C_LABEL,
+			   HWMON_C_INPUT | HWMON_C_LABEL,
+			   HWMON_C_INPUT | HWMON_C_LABEL,
+			   HWMON_C_INPUT | HWMON_C_LABEL,
+			   HWMON_C_INPUT | HWMON_C_LABEL,
+			   HWMON_C_INPUT | HWMON_C_LABEL),
+	NULL
+};
+
+/*
+ * Builds the hwmon channel info of the device from aqc_info, keeping only the attributes
+ * aqc_is_visible() allows for it. Channels past the last visible one are dropped, while
+ * hidden channels before it keep their attributes, so that channel numbers stay the same
+ */
+static const struct hwmon_channel_info **aqc_build_info(struct aqc_data *priv)
+{
+	const struct hwmon_channel_info **info;
+	const struct hwmon_channel_info *src;
+	struct device *dev = &priv->hdev->dev;
+	struct hwmon_channel_info *chinfo;
+	int i, n = 0, channel, count, last, attr;
+	u32 *config;
+
+	info = devm_kcalloc(dev, ARRAY_SIZE(aqc_info), sizeof(*info), GFP_KERNEL);
+	if (!info)
+		return NULL;
+
+	for (i = 0; aqc_info[i]; i++) {
+		src = aqc_info[i];
+
+		for (count = 0; src->config[count]; count++)
+			;
+
+		config = devm_kcalloc(dev, count + 1, sizeof(*config), GFP_KERNEL);
+		if (!config)
+			return NULL;
+
+		last = 0;
+		for (channel = 0; channel < count; channel++) {
+			for (attr = 0; attr < 32; attr++) {
+				if ((src->config[channel] & BIT(attr)) &&
+				    aqc_is_visible(priv, src->type, attr, channel))
+					config[channel] |= BIT(attr);
+			}
+			if (config[channel])
+				last = channel + 1;
+		}
+
+		if (last == 0)
+			continue;
+
+		/* A zero config would end the list early */
+		for (channel = 0; channel < last; channel++) {
+			if (!config[channel])
+				config[channel] = src->config[channel];
+		}
+		config[last] = 0;
+
+		chinfo = devm_kzalloc(dev, sizeof(*chinfo), GFP_KERNEL);
+		if (!chinfo)
+			return NULL;
+
+		chinfo->type = src->type;
+		chinfo->config = config;
+		info[n++] = chinfo;
+	}
+
+	return info;
+}
+
+/* Sample channels are the readings hwmon exposes for the device */
+static int aqc_init_sample_chans(struct aqc_data *priv)
+{
+	const struct {
+		enum hwmon_sensor_types type;
+		u32 attr;
+		int count;
+	} sources[] = {
+		{ hwmon_temp, hwmon_temp_input, priv->num_temp_channels },
+		{ hwmon_fan, hwmon_fan_input, priv->num_speed_channels },
+		{ hwmon_power, hwmon_power_input, priv->num_power_channels },
+		{ hwmon_in, hwmon_in_input, priv->num_power_channels },
+		{ hwmon_curr, hwmon_curr_input, priv->num_power_channels },
+	};
+	int i, channel, num = 0;
+
+	priv->sample_chans = devm_kcalloc(&priv->hdev->dev, AQC_MAX_SAMPLE_CHANNELS,
+					  sizeof(*priv->sample_chans), GFP_KERNEL);
+	if (!priv->sample_chans)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(sources); i++) {
+		for (channel = 0; channel < sources[i].count; channel++) {
+			if (!aqc_is_visible(priv, sources[i].type, sources[i].attr, channel))
+				continue;
+
+			priv->sample_chans[num].type = sources[i].type;
+			priv->sample_chans[num].channel = channel;
+			num++;
+		}
+	}
+
+	/* Reports may already be arriving, publish the channels once they are all set */
+	smp_store_release(&priv->num_sample_chans, num);
+
+	return 0;
+}
+
+static s32 aqc_sample_value(struct aqc_data *priv, const struct aqc_sample_chan *chan)
+{
+	switch (chan->type) {
+	case hwmon_temp:
+		return priv->temp_input[chan->channel];
+	case hwmon_fan:
+		return priv->speed_input[chan->channel];
+	case hwmon_power:
+		return priv->power_input[chan->channel];
+	case hwmon_in:
+		return priv->voltage_input[chan->channel];
+	case hwmon_curr:
+		return priv->current_input[chan->channel];
+	default:
+		return -ENODATA;
+	}
+}
+
+/* Fills in the current sample, one value per sample channel */
+static void aqc_fill_sample(struct aqc_data *priv, s32 *sample)
+{
+	s32 val;
+	int i;
+
+	for (i = 0; i < priv->num_sample_chans; i++) {
+		val = aqc_sample_value(priv, &priv->sample_chans[i]);
+		sample[i] = val == -ENODATA ? AQC_SAMPLE_NONE : val;
+	}
+}
+
+#ifdef AQC_IIO_BUFFER
+
+/*
+ * IIO device mirroring the sample channels that have a matching IIO type. Each parsed
+ * report pushes a timestamped scan into its kfifo buffer, values are in the same units
+ * as in hwmon, with scales converting power to milliwatts and speeds to radians per
+ * second
+ */
+static const enum iio_chan_type aqc_iio_chan_types[] = {
+	[hwmon_temp] = IIO_TEMP,
+	[hwmon_fan] = IIO_ANGL_VEL,
+	[hwmon_power] = IIO_POWER,
+	[hwmon_in] = IIO_VOLTAGE,
+	[hwmon_curr] = IIO_CURRENT,
+};
+
+/*
+ * Fan inputs also carry flow, pressure, conductivity and reservoir readings, which have
+ * no IIO type. Their labels name their unit in brackets, unlike rotational speeds in RPM
+ */
+static bool aqc_iio_chan_supported(struct aqc_data *priv, const struct aqc_sample_chan *chan)
+{
+	if (chan->type != hwmon_fan)
+		return true;
+
+	return priv->speed_label && !strchr(priv->speed_label[chan->channel], '[');
+}
+
+static int aqc_iio_read_raw(struct iio_dev *indio_dev, struct iio_chan_spec const *chan,
+			    int *val, int *val2, long mask)
+{
+	struct aqc_data *priv = *(struct aqc_data **)iio_priv(indio_dev);
+
+	switch (mask) {
+	case IIO_CHAN_INFO_RAW:
+		if (aqc_update(priv) < 0)
+			return -ENODATA;
+
+		*val = aqc_sample_value(priv, &priv->sample_chans[chan->address]);
+		if (*val == -ENODATA)
+			return -ENODATA;
+		return IIO_VAL_INT;
+	case IIO_CHAN_INFO_SCALE:
+		if (chan->type == IIO_ANGL_VEL) {
+			/* From RPM, 2 * pi / 60 */
+			*val = 0;
+			*val2 = 104719755;
+			return IIO_VAL_INT_PLUS_NANO;
+		}
+
+		/* From microwatts */
+		*val = 1;
+		*val2 = 1000;
+		return IIO_VAL_FRACTIONAL;
+	default:
+		return -EINVAL;
+	}
+}
+
+static const struct iio_info aqc_iio_info = {
+	.read_raw = aqc_iio_read_raw,
+};
+
+/* An enabled buffer is fed from pushed reports, so it keeps the device out of idle mode */
+static int aqc_iio_buffer_preenable(struct iio_dev *indio_dev)
+{
+	aqc_idle_hold(*(struct aqc_data **)iio_priv(indio_dev));
+
+	return 0;
+}
+
+static int aqc_iio_buffer_postdisable(struct iio_dev *indio_dev)
+{
+	aqc_idle_release(*(struct aqc_data **)iio_priv(indio_dev));
+
+	return 0;
+}
+
+static const struct iio_buffer_setup_ops aqc_iio_buffer_ops = {
+	.preenable = aqc_iio_buffer_preenable,
+	.postdisable = aqc_iio_buffer_postdisable,
+};
+
+/* The IIO device is optional, so failing to set it up only disables it */
+static int aqc_iio_init(struct aqc_data *priv)
+{
+	struct device *dev = &priv->hdev->dev;
+	const struct aqc_sample_chan *sample_chan;
+	struct iio_chan_spec *chans;
+	struct iio_dev *indio_dev;
+	int i, ret, num = 0;
+
+	indio_dev = devm_iio_device_alloc(dev, sizeof(priv));
+	if (!indio_dev)
+		return -ENOMEM;
+	*(struct aqc_data **)iio_priv(indio_dev) = priv;
+
+	chans = devm_kcalloc(dev, priv->num_sample_chans + 1, sizeof(*chans), GFP_KERNEL);
+	if (!chans)
+		return -ENOMEM;
+
+	for (i = 0; i < priv->num_sample_chans; i++) {
+		sample_chan = &priv->sample_chans[i];
+		if (!aqc_iio_chan_supported(priv, sample_chan))
+			continue;
+
+		chans[num].type = aqc_iio_chan_types[sample_chan->type];
+		chans[num].indexed = 1;
+		chans[num].channel = sample_chan->channel;
+		chans[num].address = i;
+		chans[num].info_mask_separate = BIT(IIO_CHAN_INFO_RAW);
+		if (sample_chan->type == hwmon_power || sample_chan->type == hwmon_fan)
+			chans[num].info_mask_separate |= BIT(IIO_CHAN_INFO_SCALE);
+		chans[num].scan_index = num;
+		chans[num].scan_type.sign = 's';
+		chans[num].scan_type.realbits = 32;
+		chans[num].scan_type.storagebits = 32;
+		chans[num].scan_type.endianness = IIO_CPU;
+		num++;
+	}
+	chans[num] = (struct iio_chan_spec)IIO_CHAN_SOFT_TIMESTAMP(num);
+
+	/* Sized for the whole sample, which is filled in before picking the IIO channels */
+	priv->iio_scan = devm_kzalloc(dev, ALIGN(priv->num_sample_chans * sizeof(s32),
+						 sizeof(s64)) + sizeof(s64), GFP_KERNEL);
+	if (!priv->iio_scan)
+		return -ENOMEM;
+	priv->iio_chans = chans;
+	priv->iio_num_chans = num;
+
+	indio_dev->name = priv->name;
+	indio_dev->info = &aqc_iio_info;
+	indio_dev->modes = INDIO_DIRECT_MODE;
+	indio_dev->channels = chans;
+	indio_dev->num_channels = num + 1;
+
+#if KERNEL_VERSION(5, 19, 0) <= LINUX_VERSION_CODE
+	ret = devm_iio_kfifo_buffer_setup(dev, indio_dev, &aqc_iio_buffer_ops);
+#else
+	ret = devm_iio_kfifo_buffer_setup(dev, indio_dev, INDIO_BUFFER_SOFTWARE,
+					  &aqc_iio_buffer_ops);
+#endif
+	if (ret < 0)
+		return ret;
+
+	ret = iio_device_register(indio_dev);
+	if (ret < 0)
+		return ret;
+
+	/* raw_event may already be running, publish the device once it is fully set up */
+	smp_store_release(&priv->indio_dev, indio_dev);
+
+	return 0;
+}
+
+static void aqc_iio_push(struct aqc_data *priv)
+{
+	struct iio_dev *indio_dev = smp_load_acquire(&priv->indio_dev);
+	int i;
+
+	if (!indio_dev || !iio_buffer_enabled(indio_dev))
+		return;
+
+	aqc_fill_sample(priv, priv->iio_scan);
+
+	/* Channels only ever drop out, so packing the scan in place is safe */
+	for (i = 0; i < priv->iio_num_chans; i++)
+		priv->iio_scan[i] = priv->iio_scan[priv->iio_chans[i].address];
+
+	iio_push_to_buffers_with_timestamp(indio_dev, priv->iio_scan, iio_get_time_ns(indio_dev));
+}
+
+static void aqc_iio_remove(struct aqc_data *priv)
+{
+	if (priv->indio_dev)
+		iio_device_unregister(priv->indio_dev);
+}
+
+#else
+
+static int aqc_iio_init(struct aqc_data *priv)
+{
+	return 0;
+}
+
+static void aqc_iio_push(struct aqc_data *priv)
+{
+}
+
+static void aqc_iio_remove(struct aqc_data *priv)
+{
+}
+
+#endif
+
+/*
+ * Generic netlink family, multicasting a message for every sensor report of every
+ * device to the sensors group. Each message carries the device name, kind, serial
+ * number and a timestamp, along with the sample channels and their values
+ */
+#define AQC_GENL_NAME		"aquacomputer"
+#define AQC_GENL_VERSION	1
+#define AQC_GENL_MCGRP_SENSORS	"sensors"
+#define AQC_GENL_SERIAL_LEN	12	/* As "%05u-%05u" */
+
+enum aqc_genl_cmd {
+	AQC_GENL_CMD_UNSPEC,
+	AQC_GENL_CMD_SAMPLE,
+};
+
+enum aqc_genl_attr {
+	AQC_GENL_A_UNSPEC,
+	AQC_GENL_A_DEVICE,	/* String, name of the HID device */
+	AQC_GENL_A_KIND,	/* String, same as the hwmon name */
+	AQC_GENL_A_SERIAL,	/* String */
+	AQC_GENL_A_TIMESTAMP,	/* u64, CLOCK_REALTIME in ns */
+	AQC_GENL_A_CHANNELS,	/* u16 array, channel type << 8 | channel index */
+	AQC_GENL_A_SAMPLE,	/* s32 array, value for each channel */
+	AQC_GENL_A_PAD,
+	__AQC_GENL_A_MAX,
+};
+
+#define AQC_GENL_A_MAX		(__AQC_GENL_A_MAX - 1)
+
+/* Channel types as sent in AQC_GENL_A_CHANNELS */
+static const u8 aqc_genl_chan_types[] = {
+	[hwmon_temp] = 0,
+	[hwmon_fan] = 1,
+	[hwmon_power] = 2,
+	[hwmon_in] = 3,
+	[hwmon_curr] = 4,
+};
+
+static const struct genl_multicast_group aqc_genl_mcgrps[] = {
+	{ .name = AQC_GENL_MCGRP_SENSORS },
+};
+
+static struct genl_family aqc_genl_family __ro_after_init = {
+	.name = AQC_GENL_NAME,
+	.version = AQC_GENL_VERSION,
+	.maxattr = AQC_GENL_A_MAX,
+	.module = THIS_MODULE,
+	.mcgrps = aqc_genl_mcgrps,
+	.n_mcgrps = ARRAY_SIZE(aqc_genl_mcgrps),
+};
+
+/* Whether anyone subscribed to the sensors group, which keeps idle devices streaming */
+static bool aqc_genl_listening(void)
+{
+	return genl_has_listeners(&aqc_genl_family, &init_net, 0);
+}
+
+/* Called from raw_event, so it must not sleep */
+static void aqc_genl_notify(struct aqc_data *priv)
+{
+	const char *device = dev_name(&priv->hdev->dev);
+	int i, num = smp_load_acquire(&priv->num_sample_chans);
+	char serial[AQC_GENL_SERIAL_LEN];
+	struct sk_buff *skb;
+	struct nlattr *nla;
+	u16 *chans;
+	void *hdr;
+
+	if (num == 0 || !aqc_genl_listening())
+		return;
+
+	skb = genlmsg_new(nla_total_size(strlen(device) + 1) +
+			  nla_total_size(strlen(priv->name) + 1) +
+			  nla_total_size(AQC_GENL_SERIAL_LEN) +
+			  nla_total_size_64bit(sizeof(u64)) +
+			  nla_total_size(num * sizeof(u16)) +
+			  nla_total_size(num * sizeof(s32)), GFP_ATOMIC);
+	if (!skb)
+		return;
+
+	hdr = genlmsg_put(skb, 0, 0, &aqc_genl_family, 0, AQC_GENL_CMD_SAMPLE);
+	if (!hdr)
+		goto free_and_return;
+
+	scnprintf(serial, sizeof(serial), "%05u-%05u", priv->serial_number[0],
+		  priv->serial_number[1]);
+
+	if (nla_put_string(skb, AQC_GENL_A_DEVICE, device) ||
+	    nla_put_string(skb, AQC_GENL_A_KIND, priv->name) ||
+	    nla_put_string(skb, AQC_GENL_A_SERIAL, serial) ||
+	    nla_put_u64_64bit(skb, AQC_GENL_A_TIMESTAMP, ktime_get_real_ns(), AQC_GENL_A_PAD))
+		goto free_and_return;
+
+	nla = nla_reserve(skb, AQC_GENL_A_CHANNELS, num * sizeof(u16));
+	if (!nla)
+		goto free_and_return;
+
+	chans = nla_data(nla);
+	for (i = 0; i < num; i++)
+		chans[i] = aqc_genl_chan_types[priv->sample_chans[i].type] << 8 |
+			   priv->sample_chans[i].channel;
+
+	/* Values are written straight into the message */
+	nla = nla_reserve(skb, AQC_GENL_A_SAMPLE, num * sizeof(s32));
+	if (!nla)
+		goto free_and_return;
+
+	aqc_fill_sample(priv, nla_data(nla));
+
+	genlmsg_end(skb, hdr);
+	genlmsg_multicast(&aqc_genl_family, skb, 0, 0, GFP_ATOMIC);
+	return;
+
+free_and_return:
+	nlmsg_free(skb);
+}
+
+/*
+ * Ring of the most recent samples, exposed through a read-only mmap of a misc device.
+ * The buffer starts with struct aqc_ring_header, and its slots start at data_offset.
+ * While a slot is being written, its seq is odd. Once written, it is twice the number
+ * of the sample in it, counting from 1. Sequence numbers are 32 bits wide, so 32-bit
+ * readers can load them in one go, and wrap around
+ */
+#define AQC_RING_VERSION	1
+#define AQC_RING_SLOTS		256
+
+struct aqc_ring_header {
+	u32 version;
+	u32 num_channels;
+	u32 num_slots;
+	u32 slot_size;		/* In bytes */
+	u32 data_offset;	/* Of the first slot, in bytes */
+	u32 seq;		/* Samples written so far */
+	u16 channels[AQC_MAX_SAMPLE_CHANNELS];	/* Encoded like AQC_GENL_A_CHANNELS */
+};
+
+struct aqc_ring_slot {
+	u32 seq;
+	u32 reserved;
+	u64 timestamp;		/* CLOCK_REALTIME in ns */
+	s32 values[];
+};
+
+/* Outlives the device for as long as the misc device is open */
+struct aqc_ring {
+	struct kref kref;
+	struct miscdevice misc;
+	void *buf;
+	size_t slot_size;
+	struct mutex lock;	/* Protects priv */
+	struct aqc_data *priv;	/* NULL once the device is being removed */
+};
+
+static void aqc_ring_release(struct kref *kref)
+{
+	struct aqc_ring *ring = container_of(kref, struct aqc_ring, kref);
+
+	vfree(ring->buf);
+	kfree(ring->misc.name);
+	kfree(ring);
+}
+
+static int aqc_ring_open(struct inode *inode, struct file *file)
+{
+	struct aqc_ring *ring = container_of(file->private_data, struct aqc_ring, misc);
+
+	kref_get(&ring->kref);
+
+	/* Readers of the ring keep the device out of idle mode */
+	mutex_lock(&ring->lock);
+	if (ring->priv)
+		aqc_idle_hold(ring->priv);
+	mutex_unlock(&ring->lock);
+
+	return 0;
+}
+
+static int aqc_ring_close(struct inode *inode, struct file *file)
+{
+	struct aqc_ring *ring = container_of(file->private_data, struct aqc_ring, misc);
+
+	mutex_lock(&ring->lock);
+	if (ring->priv)
+		aqc_idle_release(ring->priv);
+	mutex_unlock(&ring->lock);
+
+	kref_put(&ring->kref, aqc_ring_release);
+
+	return 0;
+}
+
+static int aqc_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct aqc_ring *ring = container_of(file->private_data, struct aqc_ring, misc);
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if KERNEL_VERSION(6, 3, 0) <= LINUX_VERSION_CODE
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	return remap_vmalloc_range(vma, ring->buf, vma->vm_pgoff);
+}
+
+static const struct file_operations aqc_ring_fops = {
+	.owner = THIS_MODULE,
+	.open = aqc_ring_open,
+	.release = aqc_ring_close,
+	.mmap = aqc_ring_mmap,
+	.llseek = noop_llseek,
+};
+
+/* The ring is optional, so failing to set it up only disables it */
+static int aqc_ring_init(struct aqc_data *priv)
+{
+	struct aqc_ring_header *hdr;
+	struct aqc_ring *ring;
+	size_t data_offset;
+	int i, ret;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
 
-	return sprintf(buf, "%d\n", aqc_get_bit_at_pos(val, FAN_CURVE_HOLD_MIN_POWER_BIT_POS));
-}
+	kref_init(&ring->kref);
+	mutex_init(&ring->lock);
+	ring->priv = priv;
+	ring->slot_size = ALIGN(sizeof(struct aqc_ring_slot) +
+				priv->num_sample_chans * sizeof(s32), sizeof(u64));
+	data_offset = PAGE_ALIGN(sizeof(*hdr));
 
-static ssize_t
-store_curve_power_hold_min(struct device *dev, struct device_attribute *attr, const char *buf,
-			   size_t count)
-{
-	struct aqc_data *priv = dev_get_drvdata(dev);
-	struct sensor_device_attribute *sattr = to_sensor_dev_attr(attr);
-	int index = sattr->index;
-	unsigned long val, new_val;
-	int ret = kstrtoul(buf, 10, &val);
+	ring->buf = vmalloc_user(PAGE_ALIGN(data_offset + AQC_RING_SLOTS * ring->slot_size));
+	if (!ring->buf) {
+		ret = -ENOMEM;
+		goto fail_and_free;
+	}
 
-	if (ret < 0)
-		return ret;
-	if (val > 2)
-		return -EINVAL;
+	hdr = ring->buf;
+	hdr->version = AQC_RING_VERSION;
+	hdr->num_channels = priv->num_sample_chans;
+	hdr->num_slots = AQC_RING_SLOTS;
+	hdr->slot_size = ring->slot_size;
+	hdr->data_offset = data_offset;
+	for (i = 0; i < priv->num_sample_chans; i++)
+		hdr->channels[i] = aqc_genl_chan_types[priv->sample_chans[i].type] << 8 |
+				   priv->sample_chans[i].channel;
+
+	ring->misc.minor = MISC_DYNAMIC_MINOR;
+	ring->misc.name = kasprintf(GFP_KERNEL, "aquacomputer_%s-%s", priv->name,
+				    dev_name(&priv->hdev->dev));
+	ring->misc.fops = &aqc_ring_fops;
+	ring->misc.parent = &priv->hdev->dev;
+	ring->misc.mode = 0444;
+	if (!ring->misc.name) {
+		ret = -ENOMEM;
+		goto fail_and_free;
+	}
 
-	ret = aqc_get_ctrl_val(priv, priv->fan_curve_hold_start_offsets[index], &new_val, AQC_8);
+	ret = misc_register(&ring->misc);
 	if (ret < 0)
-		return ret;
+		goto fail_and_free;
 
-	new_val = aqc_set_bit_at_pos(new_val, FAN_CURVE_HOLD_MIN_POWER_BIT_POS, val);
+	/* raw_event may already be running, publish the ring once it is fully set up */
+	smp_store_release(&priv->ring, ring);
 
-	ret = aqc_set_ctrl_val(priv, priv->fan_curve_hold_start_offsets[index], new_val, AQC_8);
-	if (ret < 0)
-		return ret;
+	return 0;
 
-	return count;
+fail_and_free:
+	aqc_ring_release(&ring->kref);
+	return ret;
 }
 
-SENSOR_TEMPLATE(curve_power_min, "curve%d_power_min",
-		0644, show_curve_power_min, store_curve_power_min, 0);
-SENSOR_TEMPLATE(curve_power_max, "curve%d_power_max",
-		0644, show_curve_power_max, store_curve_power_max, 0);
-SENSOR_TEMPLATE(curve_power_fallback, "curve%d_power_fallback",
-		0644, show_curve_power_fallback, store_curve_power_fallback, 0);
-SENSOR_TEMPLATE(curve_start_boost, "curve%d_start_boost",
-		0644, show_curve_start_boost, store_curve_start_boost, 0);
-SENSOR_TEMPLATE(curve_power_hold_min, "curve%d_power_hold_min",
-		0644, show_curve_power_hold_min, store_curve_power_hold_min, 0);
-
-static umode_t aqc_params_is_visible(struct kobject *kobj, struct attribute *attr, int index)
+/* Called from raw_event, the only writer */
+static void aqc_ring_push(struct aqc_data *priv)
 {
-	/*
-	 * Pump channel on the D5 Next does not support the last two features,
-	 * "start boost" and "hold min power". Every other fan curve supports
-	 * all parameters.
-	 */
-	struct device *dev = kobj_to_dev(kobj);
-	struct aqc_data *priv = dev_get_drvdata(dev);
-	int nr = index % 5;
-
-	if (priv->kind == d5next && nr > 2)
-		return 0;
-
-	return attr->mode;
+	struct aqc_ring *ring = smp_load_acquire(&priv->ring);
+	struct aqc_ring_header *hdr;
+	struct aqc_ring_slot *slot;
+	u32 seq;
+
+	if (!ring)
+		return;
+
+	hdr = ring->buf;
+	seq = hdr->seq;
+	slot = ring->buf + hdr->data_offset + (seq % AQC_RING_SLOTS) * ring->slot_size;
+
+	WRITE_ONCE(slot->seq, 2 * seq + 1);
+	smp_wmb();
+	slot->timestamp = ktime_get_real_ns();
+	aqc_fill_sample(priv, slot->values);
+	smp_wmb();
+	WRITE_ONCE(slot->seq, 2 * (seq + 1));
+
+	smp_store_release(&hdr->seq, seq + 1);
 }
 
-static struct sensor_device_template *aqc_attributes_params_template[] = {
-	&sensor_dev_template_curve_power_min,
-	&sensor_dev_template_curve_power_max,
-	&sensor_dev_template_curve_power_fallback,
-	&sensor_dev_template_curve_start_boost,
-	&sensor_dev_template_curve_power_hold_min,
-	NULL
-};
+/* Stops open ring files from reaching into the device, which is going away */
+static void aqc_ring_detach(struct aqc_data *priv)
+{
+	if (!priv->ring)
+		return;
 
-static const struct sensor_template_group aqc_curve_params_template_group = {
-	.templates = aqc_attributes_params_template,
-	.is_visible = aqc_params_is_visible,
-	.base = 1,
-};
+	mutex_lock(&priv->ring->lock);
+	priv->ring->priv = NULL;
+	mutex_unlock(&priv->ring->lock);
+}
 
-static const struct hwmon_ops aqc_hwmon_ops = {
-	.is_visible = aqc_is_visible,
-	.read = aqc_read,
-	.read_string = aqc_read_string,
-	.write = aqc_write
-};
+static void aqc_ring_remove(struct aqc_data *priv)
+{
+	if (!priv->ring)
+		return;
 
-static const struct hwmon_channel_info * const aqc_info[] = {
-	HWMON_CHANNEL_INFO(temp,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_OFFSET,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL,
-			   HWMON_T_INPUT | HWMON_T_LABEL),
-	HWMON_CHANNEL_INFO(fan,
-			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX |
-			   HWMON_F_TARGET,
-			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX,
-			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX,
-			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN | HWMON_F_MAX,
-			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_PULSES,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_PULSES,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL),
-	HWMON_CHANNEL_INFO(power,
-			   HWMON_P_INPUT | HWMON_P_LABEL,
-			   HWMON_P_INPUT | HWMON_P_LABEL,
-			   HWMON_P_INPUT | HWMON_P_LABEL,
-			   HWMON_P_INPUT | HWMON_P_LABEL,
-			   HWMON_P_INPUT | HWMON_P_LABEL,
-			   HWMON_P_INPUT | HWMON_P_LABEL,
-			   HWMON_P_INPUT | HWMON_P_LABEL,
-			   HWMON_P_INPUT | HWMON_P_LABEL),
-	HWMON_CHANNEL_INFO(pwm,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
-			   HWMON_PWM_MODE,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
-			   HWMON_PWM_MODE,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
-			   HWMON_PWM_MODE,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP |
-			   HWMON_PWM_MODE,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP,
-			   HWMON_PWM_INPUT | HWMON_PWM_ENABLE | HWMON_PWM_AUTO_CHANNELS_TEMP),
-	HWMON_CHANNEL_INFO(in,
-			   HWMON_I_INPUT | HWMON_I_LABEL,
-			   HWMON_I_INPUT | HWMON_I_LABEL,
-			   HWMON_I_INPUT | HWMON_I_LABEL,
-			   HWMON_I_INPUT | HWMON_I_LABEL,
-			   HWMON_I_INPUT | HWMON_I_LABEL,
-			   HWMON_I_INPUT | HWMON_I_LABEL,
-			   HWMON_I_INPUT | HWMON_I_LABEL,
-			   HWMON_I_INPUT | HWMON_I_LABEL),
-	HWMON_CHANNEL_INFO(curr,
-			   HWMON_C_INPUT | HWMON_C_LABEL,
-			   HWMON_C_INPUT | HWMON_C_LABEL,
-			   HWMON_C_INPUT | HWMON_C_LABEL,
-			   HWMON_C_INPUT | HWMON_C_LABEL,
-			   HWMON_C_INPUT | HWMON_C_LABEL,
-			   HWMON_C_INPUT | HWMON_C_LABEL,
-			   HWMON_C_INPUT | HWMON_C_LABEL,
-			   HWMON_C_INPUT | HWMON_C_LABEL),
-	NULL
-};
+	misc_deregister(&priv->ring->misc);
+	kref_put(&priv->ring->kref, aqc_ring_release);
+}
 
-static const struct hwmon_chip_info aqc_chip_info = {
-	.ops = &aqc_hwmon_ops,
-	.info = aqc_info,
-};
+/* Hands a freshly parsed sensor report to the streaming interfaces */
+static void aqc_push_sample(struct aqc_data *priv)
+{
+	aqc_iio_push(priv);
+	aqc_genl_notify(priv);
+	aqc_ring_push(priv);
+}
 
 static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8 *data, int size)
 {
-	int i, j;
+	int i, j, offset;
 	s16 sensor_value;
 	struct aqc_data *priv;
 
@@ -2565,15 +6552,15 @@ static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8
 	priv = hid_get_drvdata(hdev);
 
 	/* Info provided with every report */
-	priv->serial_number[0] = get_unaligned_be16(data + priv->serial_number_start_offset);
+	priv->serial_number[0] = get_unaligned_be16(data + priv->desc->serial_number_start_offset);
 	priv->serial_number[1] =
-	    get_unaligned_be16(data + priv->serial_number_start_offset + SERIAL_PART_OFFSET);
-	priv->firmware_version = get_unaligned_be16(data + priv->firmware_version_offset);
+	    get_unaligned_be16(data + priv->desc->serial_number_start_offset + SERIAL_PART_OFFSET);
+	priv->firmware_version = get_unaligned_be16(data + priv->desc->firmware_version_offset);
 
 	/* Normal temperature sensor readings */
-	for (i = 0; i < priv->num_temp_sensors; i++) {
+	for (i = 0; i < priv->desc->num_temp_sensors; i++) {
 		sensor_value = get_unaligned_be16(data +
-						  priv->temp_sensor_start_offset +
+						  priv->desc->temp_sensor_start_offset +
 						  i * AQC_SENSOR_SIZE);
 		if (sensor_value == AQC_SENSOR_NA)
 			priv->temp_input[i] = -ENODATA;
@@ -2582,9 +6569,9 @@ static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8
 	}
 
 	/* Virtual temperature sensor readings */
-	for (j = 0; j < priv->num_virtual_temp_sensors; j++) {
+	for (j = 0; j < priv->desc->num_virtual_temp_sensors; j++) {
 		sensor_value = get_unaligned_be16(data +
-						  priv->virtual_temp_sensor_start_offset +
+						  priv->desc->virtual_temp_sensor_start_offset +
 						  j * AQC_SENSOR_SIZE);
 		if (sensor_value == AQC_SENSOR_NA)
 			priv->temp_input[i] = -ENODATA;
@@ -2594,30 +6581,32 @@ static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8
 	}
 
 	/* Fan speed and related readings */
-	for (i = 0; i < priv->num_fans; i++) {
+	for (i = 0; i < priv->desc->num_fans; i++) {
 		priv->speed_input[i] =
-		    get_unaligned_be16(data + priv->fan_sensor_offsets[i] +
-				       priv->fan_structure->speed);
+		    get_unaligned_be16(data + priv->desc->fan_sensor_offsets[i] +
+				       priv->desc->fan_structure->speed);
 		priv->power_input[i] =
-		    get_unaligned_be16(data + priv->fan_sensor_offsets[i] +
-				       priv->fan_structure->power) * 10000;
+		    get_unaligned_be16(data + priv->desc->fan_sensor_offsets[i] +
+				       priv->desc->fan_structure->power) * 10000;
 		priv->voltage_input[i] =
-		    get_unaligned_be16(data + priv->fan_sensor_offsets[i] +
-				       priv->fan_structure->voltage) * 10;
+		    get_unaligned_be16(data + priv->desc->fan_sensor_offsets[i] +
+				       priv->desc->fan_structure->voltage) * 10;
 		priv->current_input[i] =
-		    get_unaligned_be16(data + priv->fan_sensor_offsets[i] +
-				       priv->fan_structure->curr);
+		    get_unaligned_be16(data + priv->desc->fan_sensor_offsets[i] +
+				       priv->desc->fan_structure->curr);
 	}
 
 	/* Flow sensor readings */
-	for (j = 0; j < priv->num_flow_sensors; j++) {
-		priv->speed_input[i] = get_unaligned_be16(data + priv->flow_sensors_start_offset +
+	for (j = 0; j < priv->desc->num_flow_sensors; j++) {
+		priv->speed_input[i] = get_unaligned_be16(data +
+							  priv->desc->flow_sensors_start_offset +
 							  j * AQC_SENSOR_SIZE);
 		i++;
 	}
 
-	if (priv->power_cycle_count_offset != 0)
-		priv->power_cycles = get_unaligned_be32(data + priv->power_cycle_count_offset);
+	if (priv->desc->power_cycle_count_offset != 0)
+		priv->power_cycles = get_unaligned_be32(data +
+							priv->desc->power_cycle_count_offset);
 
 	/* Special-case sensor readings */
 	switch (priv->kind) {
@@ -2641,10 +6630,10 @@ static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8
 		priv->total_uptime = get_unaligned_be32(data + AQUAERO_TOTAL_UPTIME_OFFSET);
 
 		/* Read Aquabus flow sensors */
-		for (j = 0; j < priv->num_aquabus_flow_sensors; j++) {
-			sensor_value = get_unaligned_be16(data +
-							  priv->aquabus_flow_sensors_start_offset +
-							  j * AQC_SENSOR_SIZE);
+		for (j = 0; j < priv->desc->num_aquabus_flow_sensors; j++) {
+			offset = priv->desc->aquabus_flow_sensors_start_offset +
+				 j * AQC_SENSOR_SIZE;
+			sensor_value = get_unaligned_be16(data + offset);
 
 			if (sensor_value == AQC_SENSOR_NA)
 				priv->speed_input[i] = -ENODATA;
@@ -2654,11 +6643,11 @@ static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8
 		}
 
 		/* Read calculated virtual temp sensors */
-		i = priv->num_temp_sensors + priv->num_virtual_temp_sensors;
-		for (j = 0; j < priv->num_calc_virt_temp_sensors; j++) {
-			sensor_value = get_unaligned_be16(data +
-							  priv->calc_virt_temp_sensor_start_offset
-							  + j * AQC_SENSOR_SIZE);
+		i = priv->desc->num_temp_sensors + priv->desc->num_virtual_temp_sensors;
+		for (j = 0; j < priv->desc->num_calc_virt_temp_sensors; j++) {
+			offset = priv->desc->calc_virt_temp_sensor_start_offset +
+				 j * AQC_SENSOR_SIZE;
+			sensor_value = get_unaligned_be16(data + offset);
 			if (sensor_value == AQC_SENSOR_NA)
 				priv->temp_input[i] = -ENODATA;
 			else
@@ -2667,10 +6656,10 @@ static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8
 		}
 
 		/* Read Aquabus temp sensors */
-		for (j = 0; j < priv->num_aquabus_temp_sensors; j++) {
-			sensor_value = get_unaligned_be16(data +
-							  priv->aquabus_temp_sensor_start_offset
-							  + j * AQC_SENSOR_SIZE);
+		for (j = 0; j < priv->desc->num_aquabus_temp_sensors; j++) {
+			offset = priv->desc->aquabus_temp_sensor_start_offset +
+				 j * AQC_SENSOR_SIZE;
+			sensor_value = get_unaligned_be16(data + offset);
 			if (sensor_value == AQC_SENSOR_NA)
 				priv->temp_input[i] = -ENODATA;
 			else
@@ -2737,14 +6726,101 @@ static int aqc_raw_event(struct hid_device *hdev, struct hid_report *report, u8
 		break;
 	}
 
+	aqc_process_report(priv);
 	priv->updated = jiffies;
+	aqc_push_sample(priv);
+
+	if (!completion_done(&priv->report_received))
+		complete_all(&priv->report_received);
+
+	return 0;
+}
+
+/* Highest visible channel of the given hwmon input, plus one */
+static int aqc_count_visible(const struct aqc_data *priv, enum hwmon_sensor_types type,
+			     u32 attr, int max)
+{
+	int channel;
+
+	for (channel = max; channel > 0; channel--) {
+		if (aqc_is_visible(priv, type, attr, channel - 1))
+			break;
+	}
+
+	return channel;
+}
+
+/*
+ * Allocates sensor values, trends and history for the channels the device has. Reports
+ * are parsed into the channels counted from the sensor numbers, while some devices also
+ * place special readings into further ones that are visible, so take the larger count.
+ * This runs before any report is parsed, which needs the buffers, so the counts may only
+ * depend on the model. In particular, the Aquaero hardware version isn't known yet, and
+ * only decides which pwm entries are visible, not how many channels there are
+ */
+static int aqc_init_channels(struct aqc_data *priv)
+{
+	struct device *dev = &priv->hdev->dev;
+
+	priv->num_temp_channels =
+	    max(priv->desc->num_temp_sensors + priv->desc->num_virtual_temp_sensors +
+		priv->desc->num_calc_virt_temp_sensors + priv->desc->num_aquabus_temp_sensors,
+		aqc_count_visible(priv, hwmon_temp, hwmon_temp_input, AQC_MAX_TEMP_CHANNELS));
+	priv->num_speed_channels =
+	    max(priv->desc->num_fans + priv->desc->num_flow_sensors +
+		priv->desc->num_aquabus_flow_sensors,
+		aqc_count_visible(priv, hwmon_fan, hwmon_fan_input, AQC_MAX_SPEED_CHANNELS));
+	priv->num_power_channels =
+	    max3(aqc_count_visible(priv, hwmon_power, hwmon_power_input, AQC_MAX_POWER_CHANNELS),
+		 aqc_count_visible(priv, hwmon_in, hwmon_in_input, AQC_MAX_POWER_CHANNELS),
+		 aqc_count_visible(priv, hwmon_curr, hwmon_curr_input, AQC_MAX_POWER_CHANNELS));
+	priv->num_power_channels = max(priv->num_power_channels, priv->desc->num_fans);
+
+	priv->temp_input = devm_kcalloc(dev, priv->num_temp_channels, sizeof(*priv->temp_input),
+					GFP_KERNEL);
+	priv->temp_trend = devm_kcalloc(dev, priv->num_temp_channels, sizeof(*priv->temp_trend),
+					GFP_KERNEL);
+	priv->temp_history = devm_kcalloc(dev, priv->num_temp_channels,
+					  sizeof(*priv->temp_history), GFP_KERNEL);
+	if (!priv->temp_input || !priv->temp_trend || !priv->temp_history)
+		return -ENOMEM;
+
+	priv->speed_input = devm_kcalloc(dev, priv->num_speed_channels,
+					 sizeof(*priv->speed_input), GFP_KERNEL);
+	priv->speed_input_min = devm_kcalloc(dev, priv->num_speed_channels,
+					     sizeof(*priv->speed_input_min), GFP_KERNEL);
+	priv->speed_input_max = devm_kcalloc(dev, priv->num_speed_channels,
+					     sizeof(*priv->speed_input_max), GFP_KERNEL);
+	priv->speed_trend = devm_kcalloc(dev, priv->num_speed_channels,
+					 sizeof(*priv->speed_trend), GFP_KERNEL);
+	priv->speed_history = devm_kcalloc(dev, priv->num_speed_channels,
+					   sizeof(*priv->speed_history), GFP_KERNEL);
+	priv->volume = devm_kcalloc(dev, priv->num_speed_channels, sizeof(*priv->volume),
+				    GFP_KERNEL);
+	if (!priv->speed_input || !priv->speed_input_min || !priv->speed_input_max ||
+	    !priv->speed_trend || !priv->speed_history || !priv->volume)
+		return -ENOMEM;
+
+	priv->power_input = devm_kcalloc(dev, priv->num_power_channels,
+					 sizeof(*priv->power_input), GFP_KERNEL);
+	priv->voltage_input = devm_kcalloc(dev, priv->num_power_channels,
+					   sizeof(*priv->voltage_input), GFP_KERNEL);
+	priv->current_input = devm_kcalloc(dev, priv->num_power_channels,
+					   sizeof(*priv->current_input), GFP_KERNEL);
+	priv->power_history = devm_kcalloc(dev, priv->num_power_channels,
+					   sizeof(*priv->power_history), GFP_KERNEL);
+	priv->energy = devm_kcalloc(dev, priv->num_power_channels, sizeof(*priv->energy),
+				    GFP_KERNEL);
+	if (!priv->power_input || !priv->voltage_input || !priv->current_input ||
+	    !priv->power_history || !priv->energy)
+		return -ENOMEM;
 
 	return 0;
 }
 
 #ifdef CONFIG_DEBUG_FS
 
-static int serial_number_show(struct seq_file *seqf, void *unused)
+static int serial_number_debugfs_show(struct seq_file *seqf, void *unused)
 {
 	struct aqc_data *priv = seqf->private;
 
@@ -2752,9 +6828,9 @@ static int serial_number_show(struct seq_file *seqf, void *unused)
 
 	return 0;
 }
-DEFINE_SHOW_ATTRIBUTE(serial_number);
+DEFINE_SHOW_ATTRIBUTE(serial_number_debugfs);
 
-static int firmware_version_show(struct seq_file *seqf, void *unused)
+static int firmware_version_debugfs_show(struct seq_file *seqf, void *unused)
 {
 	struct aqc_data *priv = seqf->private;
 
@@ -2762,9 +6838,9 @@ static int firmware_version_show(struct seq_file *seqf, void *unused)
 
 	return 0;
 }
-DEFINE_SHOW_ATTRIBUTE(firmware_version);
+DEFINE_SHOW_ATTRIBUTE(firmware_version_debugfs);
 
-static int power_cycles_show(struct seq_file *seqf, void *unused)
+static int power_cycles_debugfs_show(struct seq_file *seqf, void *unused)
 {
 	struct aqc_data *priv = seqf->private;
 
@@ -2772,49 +6848,46 @@ static int power_cycles_show(struct seq_file *seqf, void *unused)
 
 	return 0;
 }
-DEFINE_SHOW_ATTRIBUTE(power_cycles);
+DEFINE_SHOW_ATTRIBUTE(power_cycles_debugfs);
 
-static int hw_version_show(struct seq_file *seqf, void *unused)
+static int hw_version_debugfs_show(struct seq_file *seqf, void *unused)
 {
 	struct aqc_data *priv = seqf->private;
 
-	if (wait_for_completion_interruptible_timeout
-	    (&priv->aquaero_sensor_report_received, STATUS_UPDATE_INTERVAL) <= 0)
+	if (!completion_done(&priv->aquaero_sensor_report_received))
 		return -ENODATA;
 
 	seq_printf(seqf, "%u\n", priv->aquaero_hw_version);
 
 	return 0;
 }
-DEFINE_SHOW_ATTRIBUTE(hw_version);
+DEFINE_SHOW_ATTRIBUTE(hw_version_debugfs);
 
-static int current_uptime_show(struct seq_file *seqf, void *unused)
+static int current_uptime_debugfs_show(struct seq_file *seqf, void *unused)
 {
 	struct aqc_data *priv = seqf->private;
 
-	if (wait_for_completion_interruptible_timeout
-	    (&priv->aquaero_sensor_report_received, STATUS_UPDATE_INTERVAL) <= 0)
+	if (!completion_done(&priv->aquaero_sensor_report_received))
 		return -ENODATA;
 
 	seq_printf(seqf, "%u\n", priv->current_uptime);
 
 	return 0;
 }
-DEFINE_SHOW_ATTRIBUTE(current_uptime);
+DEFINE_SHOW_ATTRIBUTE(current_uptime_debugfs);
 
-static int total_uptime_show(struct seq_file *seqf, void *unused)
+static int total_uptime_debugfs_show(struct seq_file *seqf, void *unused)
 {
 	struct aqc_data *priv = seqf->private;
 
-	if (wait_for_completion_interruptible_timeout
-	    (&priv->aquaero_sensor_report_received, STATUS_UPDATE_INTERVAL) <= 0)
+	if (!completion_done(&priv->aquaero_sensor_report_received))
 		return -ENODATA;
 
 	seq_printf(seqf, "%u\n", priv->total_uptime);
 
 	return 0;
 }
-DEFINE_SHOW_ATTRIBUTE(total_uptime);
+DEFINE_SHOW_ATTRIBUTE(total_uptime_debugfs);
 
 static void aqc_debugfs_init(struct aqc_data *priv)
 {
@@ -2825,20 +6898,23 @@ static void aqc_debugfs_init(struct aqc_data *priv)
 
 	priv->debugfs = debugfs_create_dir(name, NULL);
 
-	if (priv->serial_number_start_offset != 0)
+	if (priv->desc->serial_number_start_offset != 0)
 		debugfs_create_file("serial_number", 0444, priv->debugfs, priv,
-				    &serial_number_fops);
-	if (priv->firmware_version_offset != 0)
+				    &serial_number_debugfs_fops);
+	if (priv->desc->firmware_version_offset != 0)
 		debugfs_create_file("firmware_version", 0444, priv->debugfs, priv,
-				    &firmware_version_fops);
-	if (priv->power_cycle_count_offset != 0)
-		debugfs_create_file("power_cycles", 0444, priv->debugfs, priv, &power_cycles_fops);
+				    &firmware_version_debugfs_fops);
+	if (priv->desc->power_cycle_count_offset != 0)
+		debugfs_create_file("power_cycles", 0444, priv->debugfs, priv,
+				    &power_cycles_debugfs_fops);
 
 	if (priv->kind == aquaero) {
-		debugfs_create_file("hw_version", 0444, priv->debugfs, priv, &hw_version_fops);
+		debugfs_create_file("hw_version", 0444, priv->debugfs, priv,
+				    &hw_version_debugfs_fops);
 		debugfs_create_file("current_uptime", 0444, priv->debugfs, priv,
-				    &current_uptime_fops);
-		debugfs_create_file("total_uptime", 0444, priv->debugfs, priv, &total_uptime_fops);
+				    &current_uptime_debugfs_fops);
+		debugfs_create_file("total_uptime", 0444, priv->debugfs, priv,
+				    &total_uptime_debugfs_fops);
 	}
 }
 
@@ -2854,7 +6930,7 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 {
 	struct aqc_data *priv;
 	struct attribute_group *group;
-	int ret, groups;
+	int ret, i, groups = 0;
 
 	priv = devm_kzalloc(&hdev->dev, sizeof(*priv), GFP_KERNEL);
 	if (!priv)
@@ -2896,24 +6972,10 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		}
 
 		priv->kind = aquaero;
+		priv->desc = &aqc_aquaero_desc;
 
-		priv->num_fans = AQUAERO_NUM_FANS;
-		priv->fan_sensor_offsets = aquaero_sensor_fan_offsets;
 		priv->fan_ctrl_offsets = aquaero_ctrl_fan_offsets;
 
-		priv->num_temp_sensors = AQUAERO_NUM_SENSORS;
-		priv->temp_sensor_start_offset = AQUAERO_SENSOR_START;
-		priv->num_virtual_temp_sensors = AQUAERO_NUM_VIRTUAL_SENSORS;
-		priv->virtual_temp_sensor_start_offset = AQUAERO_VIRTUAL_SENSOR_START;
-		priv->num_calc_virt_temp_sensors = AQUAERO_NUM_CALC_VIRTUAL_SENSORS;
-		priv->calc_virt_temp_sensor_start_offset = AQUAERO_CALC_VIRTUAL_SENSOR_START;
-		priv->num_aquabus_temp_sensors = AQUAERO_NUM_AQUABUS_SENSORS;
-		priv->aquabus_temp_sensor_start_offset = AQUAERO_AQUABUS_SENSOR_START;
-		priv->num_flow_sensors = AQUAERO_NUM_FLOW_SENSORS;
-		priv->flow_sensors_start_offset = AQUAERO_FLOW_SENSORS_START;
-		priv->num_aquabus_flow_sensors = AQUAERO_NUM_AQUABUS_FLOW_SENSORS;
-		priv->aquabus_flow_sensors_start_offset = AQUAERO_AQUABUS_FLOW_SENSORS_START;
-
 		priv->buffer_size = AQUAERO_CTRL_REPORT_SIZE;
 		priv->temp_ctrl_offset = AQUAERO_TEMP_CTRL_OFFSET;
 		priv->ctrl_report_delay = CTRL_REPORT_DELAY;
@@ -2929,9 +6991,8 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_D5NEXT:
 		priv->kind = d5next;
+		priv->desc = &aqc_d5next_desc;
 
-		priv->num_fans = D5NEXT_NUM_FANS;
-		priv->fan_sensor_offsets = d5next_sensor_fan_offsets;
 		priv->fan_ctrl_offsets = d5next_ctrl_fan_offsets;
 		priv->fan_curve_min_power_offsets = d5next_ctrl_fan_curve_min_power_offsets;
 		priv->fan_curve_max_power_offsets = d5next_ctrl_fan_curve_max_power_offsets;
@@ -2939,12 +7000,6 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		priv->fan_curve_fallback_power_offsets =
 		    d5next_ctrl_fan_curve_fallback_power_offsets;
 
-		priv->num_temp_sensors = D5NEXT_NUM_SENSORS;
-		priv->temp_sensor_start_offset = D5NEXT_COOLANT_TEMP;
-		priv->num_virtual_temp_sensors = D5NEXT_NUM_VIRTUAL_SENSORS;
-		priv->virtual_temp_sensor_start_offset = D5NEXT_VIRTUAL_SENSORS_START;
-
-		priv->power_cycle_count_offset = AQC_POWER_CYCLES;
 		priv->buffer_size = D5NEXT_CTRL_REPORT_SIZE;
 		priv->temp_ctrl_offset = D5NEXT_TEMP_CTRL_OFFSET;
 		priv->ctrl_report_delay = CTRL_REPORT_DELAY;
@@ -2958,11 +7013,7 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_FARBWERK:
 		priv->kind = farbwerk;
-
-		priv->num_fans = 0;
-
-		priv->num_temp_sensors = FARBWERK_NUM_SENSORS;
-		priv->temp_sensor_start_offset = FARBWERK_SENSOR_START;
+		priv->desc = &aqc_farbwerk_desc;
 
 		priv->temp_ctrl_offset = 0;
 
@@ -2970,13 +7021,7 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_FARBWERK360:
 		priv->kind = farbwerk360;
-
-		priv->num_fans = 0;
-
-		priv->num_temp_sensors = FARBWERK360_NUM_SENSORS;
-		priv->temp_sensor_start_offset = FARBWERK360_SENSOR_START;
-		priv->num_virtual_temp_sensors = FARBWERK360_NUM_VIRTUAL_SENSORS;
-		priv->virtual_temp_sensor_start_offset = FARBWERK360_VIRTUAL_SENSORS_START;
+		priv->desc = &aqc_farbwerk360_desc;
 
 		priv->buffer_size = FARBWERK360_CTRL_REPORT_SIZE;
 		priv->temp_ctrl_offset = FARBWERK360_TEMP_CTRL_OFFSET;
@@ -2986,23 +7031,14 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_OCTO:
 		priv->kind = octo;
+		priv->desc = &aqc_octo_desc;
 
-		priv->num_fans = OCTO_NUM_FANS;
-		priv->fan_sensor_offsets = octo_sensor_fan_offsets;
 		priv->fan_ctrl_offsets = octo_ctrl_fan_offsets;
 		priv->fan_curve_min_power_offsets = octo_ctrl_fan_curve_min_power_offsets;
 		priv->fan_curve_max_power_offsets = octo_ctrl_fan_curve_max_power_offsets;
 		priv->fan_curve_hold_start_offsets = octo_ctrl_fan_curve_hold_start_offsets;
 		priv->fan_curve_fallback_power_offsets = octo_ctrl_fan_curve_fallback_power_offsets;
 
-		priv->num_temp_sensors = OCTO_NUM_SENSORS;
-		priv->temp_sensor_start_offset = OCTO_SENSOR_START;
-		priv->num_virtual_temp_sensors = OCTO_NUM_VIRTUAL_SENSORS;
-		priv->virtual_temp_sensor_start_offset = OCTO_VIRTUAL_SENSORS_START;
-		priv->num_flow_sensors = OCTO_NUM_FLOW_SENSORS;
-		priv->flow_sensors_start_offset = OCTO_FLOW_SENSOR_OFFSET;
-
-		priv->power_cycle_count_offset = AQC_POWER_CYCLES;
 		priv->buffer_size = OCTO_CTRL_REPORT_SIZE;
 		priv->ctrl_report_delay = CTRL_REPORT_DELAY;
 		priv->temp_ctrl_offset = OCTO_TEMP_CTRL_OFFSET;
@@ -3017,9 +7053,8 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_QUADRO:
 		priv->kind = quadro;
+		priv->desc = &aqc_quadro_desc;
 
-		priv->num_fans = QUADRO_NUM_FANS;
-		priv->fan_sensor_offsets = quadro_sensor_fan_offsets;
 		priv->fan_ctrl_offsets = quadro_ctrl_fan_offsets;
 		priv->fan_curve_min_power_offsets = quadro_ctrl_fan_curve_min_power_offsets;
 		priv->fan_curve_max_power_offsets = quadro_ctrl_fan_curve_max_power_offsets;
@@ -3027,18 +7062,11 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		priv->fan_curve_fallback_power_offsets =
 		    quadro_ctrl_fan_curve_fallback_power_offsets;
 
-		priv->num_temp_sensors = QUADRO_NUM_SENSORS;
-		priv->temp_sensor_start_offset = QUADRO_SENSOR_START;
-		priv->num_virtual_temp_sensors = QUADRO_NUM_VIRTUAL_SENSORS;
-		priv->virtual_temp_sensor_start_offset = QUADRO_VIRTUAL_SENSORS_START;
-		priv->num_flow_sensors = QUADRO_NUM_FLOW_SENSORS;
-		priv->flow_sensors_start_offset = QUADRO_FLOW_SENSOR_OFFSET;
-
-		priv->power_cycle_count_offset = AQC_POWER_CYCLES;
 		priv->buffer_size = QUADRO_CTRL_REPORT_SIZE;
 		priv->ctrl_report_delay = CTRL_REPORT_DELAY;
 		priv->temp_ctrl_offset = QUADRO_TEMP_CTRL_OFFSET;
 		priv->flow_pulses_ctrl_offset = QUADRO_FLOW_PULSES_CTRL_OFFSET;
+		priv->profile_ctrl_offset = QUADRO_PROFILE_CTRL_OFFSET;
 
 		priv->temp_label = label_temp_sensors;
 		priv->virtual_temp_label = label_virtual_temp_sensors;
@@ -3049,14 +7077,7 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_HIGHFLOWNEXT:
 		priv->kind = highflownext;
-
-		priv->num_fans = 0;
-		priv->num_temp_sensors = HIGHFLOWNEXT_NUM_SENSORS;
-		priv->temp_sensor_start_offset = HIGHFLOWNEXT_SENSOR_START;
-		priv->num_flow_sensors = HIGHFLOWNEXT_NUM_FLOW_SENSORS;
-		priv->flow_sensors_start_offset = HIGHFLOWNEXT_FLOW;
-
-		priv->power_cycle_count_offset = AQC_POWER_CYCLES;
+		priv->desc = &aqc_highflownext_desc;
 
 		priv->temp_label = label_highflownext_temp_sensors;
 		priv->speed_label = label_highflownext_fan_speed;
@@ -3074,10 +7095,7 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		}
 
 		priv->kind = leakshield;
-
-		priv->num_fans = 0;
-		priv->num_temp_sensors = LEAKSHIELD_NUM_SENSORS;
-		priv->temp_sensor_start_offset = LEAKSHIELD_TEMPERATURE_1;
+		priv->desc = &aqc_leakshield_desc;
 
 		/* Plus two bytes for checksum */
 		priv->buffer_size = LEAKSHIELD_USB_REPORT_LENGTH + 2;
@@ -3087,14 +7105,10 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_AQUASTREAMXT:
 		priv->kind = aquastreamxt;
+		priv->desc = &aqc_aquastreamxt_desc;
 
-		priv->num_fans = AQUASTREAMXT_NUM_FANS;
-		priv->fan_sensor_offsets = aquastreamxt_sensor_fan_offsets;
 		priv->fan_ctrl_offsets = aquastreamxt_ctrl_fan_offsets;
 
-		priv->num_temp_sensors = AQUASTREAMXT_NUM_SENSORS;
-		priv->temp_sensor_start_offset = AQUASTREAMXT_SENSOR_START;
-
 		/*
 		 * Since we use the same buffer for both sensor and control
 		 * report storage on legacy devices, reserve enough space
@@ -3109,12 +7123,7 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_AQUASTREAMULT:
 		priv->kind = aquastreamult;
-
-		priv->num_fans = AQUASTREAMULT_NUM_FANS;
-		priv->fan_sensor_offsets = aquastreamult_sensor_fan_offsets;
-
-		priv->num_temp_sensors = AQUASTREAMULT_NUM_SENSORS;
-		priv->temp_sensor_start_offset = AQUASTREAMULT_SENSOR_START;
+		priv->desc = &aqc_aquastreamult_desc;
 
 		priv->temp_label = label_aquastreamult_temp;
 		priv->speed_label = label_aquastreamult_speeds;
@@ -3124,13 +7133,8 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_POWERADJUST3:
 		priv->kind = poweradjust3;
+		priv->desc = &aqc_poweradjust3_desc;
 
-		priv->num_fans = POWERADJUST3_NUM_FANS;
-
-		priv->num_temp_sensors = POWERADJUST3_NUM_SENSORS;
-		priv->temp_sensor_start_offset = POWERADJUST3_SENSOR_START;
-		priv->num_flow_sensors = POWERADJUST3_NUM_FLOW_SENSORS;
-		priv->flow_sensors_start_offset = POWERADJUST3_FLOW_SENSOR_OFFSET;
 		priv->buffer_size = POWERADJUST3_SENSOR_REPORT_SIZE;
 
 		priv->temp_label = label_poweradjust3_temp_sensors;
@@ -3140,40 +7144,28 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		break;
 	case USB_PRODUCT_ID_HIGHFLOW:
 		priv->kind = highflow;
+		priv->desc = &aqc_highflow_desc;
 
-		priv->num_fans = 0;
-
-		priv->num_temp_sensors = HIGHFLOW_NUM_SENSORS;
-		priv->temp_sensor_start_offset = HIGHFLOW_SENSOR_START;
-		priv->num_flow_sensors = HIGHFLOW_NUM_FLOW_SENSORS;
-		priv->flow_sensors_start_offset = HIGHFLOW_FLOW_SENSOR_OFFSET;
 		priv->buffer_size = HIGHFLOW_SENSOR_REPORT_SIZE;
 
 		priv->temp_label = label_highflow_temp;
 		priv->speed_label = label_highflow_speeds;
 		break;
 	default:
-		break;
+		ret = -ENODEV;
+		goto fail_and_close;
 	}
 
 	switch (priv->kind) {
 	case aquaero:
 		init_completion(&priv->aquaero_sensor_report_received);
 
-		priv->serial_number_start_offset = AQUAERO_SERIAL_START;
-		priv->firmware_version_offset = AQUAERO_FIRMWARE_VERSION;
-
-		priv->fan_structure = &aqc_aquaero_fan_structure;
-
 		priv->ctrl_report_id = AQUAERO_CTRL_REPORT_ID;
 		priv->secondary_ctrl_report_id = AQUAERO_SECONDARY_CTRL_REPORT_ID;
 		priv->secondary_ctrl_report_size = AQUAERO_SECONDARY_CTRL_REPORT_SIZE;
 		priv->secondary_ctrl_report = aquaero_secondary_ctrl_report;
 		break;
 	case aquastreamxt:
-		priv->serial_number_start_offset = AQUASTREAMXT_SERIAL_START;
-		priv->firmware_version_offset = AQUASTREAMXT_FIRMWARE_VERSION;
-
 		priv->status_report_id = AQUASTREAMXT_STATUS_REPORT_ID;
 		priv->ctrl_report_id = AQUASTREAMXT_CTRL_REPORT_ID;
 		priv->secondary_ctrl_report_id = AQUASTREAMXT_SECONDARY_CTRL_REPORT_ID;
@@ -3181,26 +7173,13 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		priv->secondary_ctrl_report = aquastreamxt_secondary_ctrl_report;
 		break;
 	case poweradjust3:
-		priv->serial_number_start_offset = POWERADJUST3_SERIAL_START;
-		priv->firmware_version_offset = POWERADJUST3_FIRMWARE_VERSION;
-
 		priv->status_report_id = POWERADJUST3_STATUS_REPORT_ID;
 		break;
 	case highflow:
-		priv->serial_number_start_offset = HIGHFLOW_SERIAL_START;
-		priv->firmware_version_offset = HIGHFLOW_FIRMWARE_VERSION;
-
 		priv->status_report_id = HIGHFLOW_STATUS_REPORT_ID;
 		break;
 	default:
-		priv->serial_number_start_offset = AQC_SERIAL_START;
-		priv->firmware_version_offset = AQC_FIRMWARE_VERSION;
-
-		if (priv->kind == aquastreamult) {
-			priv->fan_structure = &aqc_aquastreamult_fan_structure;
-		} else {
-			priv->fan_structure = &aqc_general_fan_structure;
-
+		if (priv->kind != aquastreamult) {
 			priv->ctrl_report_id = CTRL_REPORT_ID;
 			priv->secondary_ctrl_report_id = SECONDARY_CTRL_REPORT_ID;
 			priv->secondary_ctrl_report_size = SECONDARY_CTRL_REPORT_SIZE;
@@ -3218,17 +7197,67 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 			/* Temp-PWM curve */
 			group =
 			    aqc_create_attr_group(&hdev->dev, &aqc_curve_template_group,
-						  priv->num_fans);
-			if (IS_ERR(group))
-				return PTR_ERR(group);
+						  priv->desc->num_fans);
+			if (IS_ERR(group)) {
+				ret = PTR_ERR(group);
+				goto fail_and_close;
+			}
 			priv->groups[groups++] = group;
 
 			/* General curve parameters */
 			group =
 			    aqc_create_attr_group(&hdev->dev, &aqc_curve_params_template_group,
-						  priv->num_fans);
-			if (IS_ERR(group))
-				return PTR_ERR(group);
+						  priv->desc->num_fans);
+			if (IS_ERR(group)) {
+				ret = PTR_ERR(group);
+				goto fail_and_close;
+			}
+			priv->groups[groups++] = group;
+
+			/* PID controller parameters */
+			group =
+			    aqc_create_attr_group(&hdev->dev, &aqc_pid_template_group,
+						  priv->desc->num_fans);
+			if (IS_ERR(group)) {
+				ret = PTR_ERR(group);
+				goto fail_and_close;
+			}
+			priv->groups[groups++] = group;
+			break;
+		case aquaero:
+			/* Firmware controllers */
+			group = aqc_create_attr_group(&hdev->dev, &aquaero_two_point_template_group,
+						      AQUAERO_NUM_TWO_POINT_CTRLS);
+			if (IS_ERR(group)) {
+				ret = PTR_ERR(group);
+				goto fail_and_close;
+			}
+			priv->groups[groups++] = group;
+
+			group = aqc_create_attr_group(&hdev->dev, &aquaero_set_point_template_group,
+						      AQUAERO_NUM_SET_POINT_CTRLS);
+			if (IS_ERR(group)) {
+				ret = PTR_ERR(group);
+				goto fail_and_close;
+			}
+			priv->groups[groups++] = group;
+
+			group = aqc_create_attr_group(&hdev->dev, &aquaero_curve_template_group,
+						      AQUAERO_NUM_CURVE_CTRLS);
+			if (IS_ERR(group)) {
+				ret = PTR_ERR(group);
+				goto fail_and_close;
+			}
+			priv->groups[groups++] = group;
+			break;
+		case aquastreamxt:
+			/* Automatic mode of the fan */
+			group = aqc_create_attr_group(&hdev->dev, &aquastreamxt_auto_template_group,
+						      1);
+			if (IS_ERR(group)) {
+				ret = PTR_ERR(group);
+				goto fail_and_close;
+			}
 			priv->groups[groups++] = group;
 			break;
 		default:
@@ -3236,6 +7265,66 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 		}
 	}
 
+	ret = aqc_init_channels(priv);
+	if (ret < 0)
+		goto fail_and_close;
+
+	/* Set up sensor trends and history not covered by the hwmon core */
+	if (priv->num_temp_channels) {
+		group = aqc_create_attr_group(&hdev->dev, &aqc_temp_trend_template_group,
+					      priv->num_temp_channels);
+		if (IS_ERR(group)) {
+			ret = PTR_ERR(group);
+			goto fail_and_close;
+		}
+		priv->groups[groups++] = group;
+	}
+
+	if (priv->num_speed_channels) {
+		group = aqc_create_attr_group(&hdev->dev, &aqc_fan_trend_template_group,
+					      priv->num_speed_channels);
+		if (IS_ERR(group)) {
+			ret = PTR_ERR(group);
+			goto fail_and_close;
+		}
+		priv->groups[groups++] = group;
+
+		/* Set up flow totalizers */
+		group = aqc_create_attr_group(&hdev->dev, &aqc_volume_template_group,
+					      priv->num_speed_channels);
+		if (IS_ERR(group)) {
+			ret = PTR_ERR(group);
+			goto fail_and_close;
+		}
+		priv->groups[groups++] = group;
+	}
+
+	/* Set up PWM ramps for devices with PWM control */
+	if (priv->fan_ctrl_offsets) {
+		group = aqc_create_attr_group(&hdev->dev, &aqc_pwm_ramp_template_group,
+					      priv->desc->num_fans);
+		if (IS_ERR(group)) {
+			ret = PTR_ERR(group);
+			goto fail_and_close;
+		}
+		priv->groups[groups++] = group;
+	}
+
+	/* Set up control report profile slots */
+	priv->active_profile = -1;
+	if (aqc_has_ctrl_report(priv)) {
+		group = aqc_create_attr_group(&hdev->dev, &aqc_profile_slots_template_group,
+					      AQC_NUM_PROFILE_SLOTS);
+		if (IS_ERR(group)) {
+			ret = PTR_ERR(group);
+			goto fail_and_close;
+		}
+		priv->groups[groups++] = group;
+	}
+
+	priv->groups[groups++] = &aqc_info_attr_group;
+	priv->groups[groups++] = &aqc_ctrl_attr_group;
+
 	if (priv->buffer_size != 0) {
 		priv->checksum_start = 0x01;
 		priv->checksum_length = priv->buffer_size - 3;
@@ -3253,7 +7342,30 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 	if (priv->kind == leakshield)
 		memcpy(priv->buffer, leakshield_usb_report_template, LEAKSHIELD_USB_REPORT_LENGTH);
 
+	if (aqc_has_virt_sensors_transfer(priv)) {
+		priv->virt_sensors_buffer = devm_kzalloc(&hdev->dev, AQC_VIRT_SENSORS_SIZE,
+							 GFP_KERNEL);
+		if (!priv->virt_sensors_buffer) {
+			ret = -ENOMEM;
+			goto fail_and_close;
+		}
+
+		aqc_init_virt_sensors_buffer(priv->virt_sensors_buffer);
+	}
+
 	mutex_init(&priv->mutex);
+	priv->ctrl_report_write_delay = priv->ctrl_report_delay;
+	INIT_WORK(&priv->ctrl_report_calibration_work, aqc_ctrl_report_calibration_work);
+	spin_lock_init(&priv->pwm_ramp_lock);
+	for (i = 0; i < AQC_MAX_PWM_CHANNELS; i++)
+		priv->pwm_ramps[i].current_pwm = -1;
+	INIT_DELAYED_WORK(&priv->pwm_ramp_work, aqc_pwm_ramp_work);
+	INIT_DELAYED_WORK(&priv->virt_sensors_work, aqc_virt_sensors_work);
+	spin_lock_init(&priv->history_lock);
+	mutex_init(&priv->idle_mutex);
+	INIT_DELAYED_WORK(&priv->idle_work, aqc_idle_work);
+	init_completion(&priv->report_received);
+	priv->virt_sensors_sent = jiffies - msecs_to_jiffies(AQC_VIRT_SENSORS_MIN_INTERVAL);
 
 	if (priv->kind == aquaero) {
 		hid_device_io_start(hdev);
@@ -3269,8 +7381,15 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 				 "didn't read aquaero hw version, some functionality won't be available\n");
 	}
 
+	priv->chip_info.ops = &aqc_hwmon_ops;
+	priv->chip_info.info = aqc_build_info(priv);
+	if (!priv->chip_info.info) {
+		ret = -ENOMEM;
+		goto fail_and_close;
+	}
+
 	priv->hwmon_dev = hwmon_device_register_with_info(&hdev->dev, priv->name, priv,
-							  &aqc_chip_info, priv->groups);
+							  &priv->chip_info, priv->groups);
 	if (IS_ERR(priv->hwmon_dev)) {
 		ret = (int)PTR_ERR(priv->hwmon_dev);
 		goto fail_and_close;
@@ -3278,6 +7397,26 @@ static int aqc_probe(struct hid_device *hdev, const struct hid_device_id *id)
 
 	aqc_debugfs_init(priv);
 
+	/* Streaming interfaces are optional, only for devices that push sensor reports */
+	if (priv->status_report_id == 0) {
+		ret = aqc_init_sample_chans(priv);
+		if (ret < 0)
+			hid_warn(hdev, "failed to set up sample channels (%d)\n", ret);
+
+		if (ret == 0) {
+			ret = aqc_iio_init(priv);
+			if (ret < 0)
+				hid_warn(hdev, "failed to set up IIO device (%d)\n", ret);
+
+			ret = aqc_ring_init(priv);
+			if (ret < 0)
+				hid_warn(hdev, "failed to set up sample ring (%d)\n", ret);
+		}
+	}
+
+	if (calibrate_ctrl_report_delay && aqc_has_ctrl_report(priv))
+		schedule_work(&priv->ctrl_report_calibration_work);
+
 	return 0;
 
 fail_and_close:
@@ -3291,11 +7430,22 @@ static void aqc_remove(struct hid_device *hdev)
 {
 	struct aqc_data *priv = hid_get_drvdata(hdev);
 
+	aqc_iio_remove(priv);
+	aqc_ring_detach(priv);
 	debugfs_remove_recursive(priv->debugfs);
 	hwmon_device_unregister(priv->hwmon_dev);
 
-	hid_hw_close(hdev);
+	cancel_work_sync(&priv->ctrl_report_calibration_work);
+	cancel_delayed_work_sync(&priv->pwm_ramp_work);
+	cancel_delayed_work_sync(&priv->virt_sensors_work);
+	cancel_delayed_work_sync(&priv->idle_work);
+
+	if (!priv->idle)
+		hid_hw_close(hdev);
 	hid_hw_stop(hdev);
+
+	/* No more reports are written to the ring now */
+	aqc_ring_remove(priv);
 }
 
 static const struct hid_device_id aqc_table[] = {
@@ -3326,12 +7476,23 @@ static struct hid_driver aqc_driver = {
 
 static int __init aqc_init(void)
 {
-	return hid_register_driver(&aqc_driver);
+	int ret;
+
+	ret = genl_register_family(&aqc_genl_family);
+	if (ret < 0)
+		return ret;
+
+	ret = hid_register_driver(&aqc_driver);
+	if (ret < 0)
+		genl_unregister_family(&aqc_genl_family);
+
+	return ret;
 }
 
 static void __exit aqc_exit(void)
 {
 	hid_unregister_driver(&aqc_driver);
+	genl_unregister_family(&aqc_genl_family);
 }
 
 /* Request to initialize after the HID bus to ensure it's not being loaded before */